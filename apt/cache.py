@@ -176,12 +176,20 @@ class Cache(object):
     def get_changes(self):
         """ Get the marked changes """
         changes = []
-        for pkg in self:
-            if (pkg.marked_upgrade or pkg.marked_install or pkg.marked_delete
-                or pkg.marked_downgrade or pkg.marked_reinstall):
-                changes.append(pkg)
+        packages = self._cache.packages
+        for pkg_id in self._depcache.changed_ids():
+            name = packages[pkg_id].name
+            if name in self._set:
+                changes.append(self[name])
         return changes
 
+    def get_auto_removable(self):
+        """Get the packages which are no longer required."""
+        packages = self._cache.packages
+        return [self[packages[pkg_id].name]
+                for pkg_id in self._depcache.garbage_ids()
+                if packages[pkg_id].name in self._set]
+
     @deprecated_args
     def upgrade(self, dist_upgrade=False):
         """Upgrade all packages.
@@ -391,19 +391,20 @@ class Version(object):
     def get_dependencies(self, *types):
         """Return a list of Dependency objects for the given types."""
         depends_list = []
-        depends = self._cand.depends_list
         for type_ in types:
             try:
-                for dep_ver_list in depends[type_]:
-                    base_deps = []
-                    for dep_or in dep_ver_list:
-                        base_deps.append(BaseDependency(dep_or.target_pkg.name,
-                                        dep_or.comp_type, dep_or.target_ver,
-                                        (type_ == "PreDepends"),
-                                         rawtype=type_))
-                    depends_list.append(Dependency(base_deps))
-            except KeyError:
-                pass
+                dep_ver_lists = self._cand.iter_depends(type_)
+            except ValueError:
+                # Unknown dependency type
+                continue
+            for dep_ver_list in dep_ver_lists:
+                base_deps = []
+                for dep_or in dep_ver_list:
+                    base_deps.append(BaseDependency(dep_or.target_pkg.name,
+                                    dep_or.comp_type, dep_or.target_ver,
+                                    (type_ == "PreDepends"),
+                                     rawtype=type_))
+                depends_list.append(Dependency(base_deps))
         return depends_list
 
     @property
@@ -491,6 +491,10 @@ static PyMethodDef methods[] =
    {"parse_depends",ParseDepends,METH_VARARGS,doc_ParseDepends},
    {"parse_src_depends",ParseSrcDepends,METH_VARARGS,doc_ParseDepends},
 
+   // DepCache
+   {"evaluate_installs",(PyCFunction)EvaluateInstalls,METH_VARARGS|METH_KEYWORDS,
+    doc_EvaluateInstalls},
+
    // Stuff
    {"md5sum",md5sum,METH_VARARGS,doc_md5sum},
    {"sha1sum",sha1sum,METH_VARARGS,doc_sha1sum},
@@ -721,11 +725,15 @@ extern "C" void initapt_pkg()
    ADDTYPE(Module,"AcquireWorker",&PyAcquireWorker_Type); // NO __new__()
    /* ============================ cache.cc ============================ */
    ADDTYPE(Module,"Cache",&PyCache_Type);
+   ADDTYPE(Module,"Column",&PyColumn_Type); // NO __new__()
    ADDTYPE(Module,"Dependency",&PyDependency_Type); // NO __new__()
    ADDTYPE(Module,"Description",&PyDescription_Type); // NO __new__()
    ADDTYPE(Module,"PackageFile",&PyPackageFile_Type); // NO __new__()
    ADDTYPE(Module,"PackageList",&PyPackageList_Type);  // NO __new__(), internal
+   ADDTYPE(Module,"PackageListIterator",&PyPackageListIterator_Type);  // NO __new__(), internal
    ADDTYPE(Module,"DependencyList",&PyDependencyList_Type); // NO __new__(), internal
+   ADDTYPE(Module,"DependsIterator",&PyDependsIterator_Type); // NO __new__(), internal
+   ADDTYPE(Module,"DependsView",&PyDependsView_Type); // NO __new__(), internal
    ADDTYPE(Module,"Package",&PyPackage_Type); // NO __new__()
    ADDTYPE(Module,"Version",&PyVersion_Type); // NO __new__()
    /* ============================ cdrom.cc ============================ */
@@ -735,6 +743,7 @@ extern "C" void initapt_pkg()
    /* ========================= depcache.cc ========================= */
    ADDTYPE(Module,"ActionGroup",&PyActionGroup_Type);
    ADDTYPE(Module,"DepCache",&PyDepCache_Type);
+   ADDTYPE(Module,"DepCacheSnapshot",&PyDepCacheSnapshot_Type); // NO __new__()
    ADDTYPE(Module,"ProblemResolver",&PyProblemResolver_Type);
    /* ========================= indexfile.cc ========================= */
    ADDTYPE(Module,"IndexFile",&PyIndexFile_Type); // NO __new__()
@@ -799,6 +808,31 @@ extern "C" void initapt_pkg()
    PyDict_SetItemString(PyDependency_Type.tp_dict, "TYPE_ENHANCES",
                         Py_BuildValue("i", pkgCache::Dep::Enhances));
 
+   // DepCache constants
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_INSTALL",
+                        Py_BuildValue("i", DepCacheStateInstall));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_UPGRADE",
+                        Py_BuildValue("i", DepCacheStateUpgrade));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_DELETE",
+                        Py_BuildValue("i", DepCacheStateDelete));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_KEEP",
+                        Py_BuildValue("i", DepCacheStateKeep));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_DOWNGRADE",
+                        Py_BuildValue("i", DepCacheStateDowngrade));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_REINSTALL",
+                        Py_BuildValue("i", DepCacheStateReInstall));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_GARBAGE",
+                        Py_BuildValue("i", DepCacheStateGarbage));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_NOW_BROKEN",
+                        Py_BuildValue("i", DepCacheStateNowBroken));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_INST_BROKEN",
+                        Py_BuildValue("i", DepCacheStateInstBroken));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_AUTO",
+                        Py_BuildValue("i", DepCacheStateAuto));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_UPGRADABLE",
+                        Py_BuildValue("i", DepCacheStateUpgradable));
+   PyDict_SetItemString(PyDepCache_Type.tp_dict, "STATE_CHANGED",
+                        Py_BuildValue("i", DepCacheStateChanged));
 
    // PackageManager constants
    PyDict_SetItemString(PyPackageManager_Type.tp_dict, "RESULT_COMPLETED",
@@ -69,16 +69,48 @@ bool     PyAcquire_DropItem(PyObject *self, pkgAcquire::Item *item);
 extern PyTypeObject PyCache_Type;
 extern PyTypeObject PyCacheFile_Type;
 extern PyTypeObject PyPackageList_Type;
+extern PyTypeObject PyPackageListIterator_Type;
 extern PyTypeObject PyDescription_Type;
 extern PyTypeObject PyPackage_Type;
 extern PyTypeObject PyPackageFile_Type;
 extern PyTypeObject PyDependency_Type;
 extern PyTypeObject PyDependencyList_Type;
+extern PyTypeObject PyDependsIterator_Type;
+extern PyTypeObject PyDependsView_Type;
 PyObject *TmpGetCache(PyObject *Self,PyObject *Args);
 
+// Columns
+extern PyTypeObject PyColumn_Type;
+PyObject *PyColumn_New(char Format,Py_ssize_t Length);
+void *PyColumn_Data(PyObject *Self);
+void PyColumn_SetItem(PyObject *Self,Py_ssize_t Index,unsigned long long Value);
+
 // DepCache
 extern PyTypeObject PyDepCache_Type;
+extern PyTypeObject PyDepCacheSnapshot_Type;
 PyObject *GetDepCache(PyObject *Self,PyObject *Args);
+PyObject *EvaluateInstalls(PyObject *Self,PyObject *Args,PyObject *kwds);
+extern char *doc_EvaluateInstalls;
+
+// Flags of the package states returned by DepCache.states().
+enum DepCacheStateFlags
+{
+   DepCacheStateInstall = (1 << 0),
+   DepCacheStateUpgrade = (1 << 1),
+   DepCacheStateDelete = (1 << 2),
+   DepCacheStateKeep = (1 << 3),
+   DepCacheStateDowngrade = (1 << 4),
+   DepCacheStateReInstall = (1 << 5),
+   DepCacheStateGarbage = (1 << 6),
+   DepCacheStateNowBroken = (1 << 7),
+   DepCacheStateInstBroken = (1 << 8),
+   DepCacheStateAuto = (1 << 9),
+   DepCacheStateUpgradable = (1 << 10),
+   // The states counted as changes by changed_ids().
+   DepCacheStateChanged = (DepCacheStateInstall | DepCacheStateUpgrade |
+			   DepCacheStateDelete | DepCacheStateDowngrade |
+			   DepCacheStateReInstall)
+};
 
 // pkgProblemResolver
 extern PyTypeObject PyProblemResolver_Type;
@@ -10,6 +10,7 @@
 // Include Files							/*{{{*/
 #include "generic.h"
 #include "apt_pkgmodule.h"
+#include "cache.h"
 
 #include <apt-pkg/pkgcache.h>
 #include <apt-pkg/cachefile.h>
@@ -21,8 +22,21 @@
 #include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/sourcelist.h>
 #include <apt-pkg/algorithms.h>
+#include <apt-pkg/mmap.h>
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/policy.h>
+#include <apt-pkg/metaindex.h>
+#include <apt-pkg/indexfile.h>
 
 #include <Python.h>
+#include <ctype.h>
+#include <strings.h>
+#include <fnmatch.h>
+#include <regex.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <algorithm>
 #include "progress.h"
 
 class pkgSourceList;
@@ -41,13 +55,22 @@ const char *UntranslatedDepTypes[] =
 									/*}}}*/
 struct PkgListStruct
 {
-   pkgCache::PkgIterator Iter;
-   unsigned long LastIndex;
+};
+
+struct PkgListIterStruct
+{
+   // The ID of the next package returned by the iterator.
+   unsigned long Pos;
 
-   PkgListStruct(pkgCache::PkgIterator const &I) : Iter(I), LastIndex(0) {}
-   PkgListStruct() {abort();};  // G++ Bug..
+   PkgListIterStruct() : Pos(0) {}
 };
 
+#if PY_MAJOR_VERSION < 3 || (PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION < 2)
+#define SLICE_CAST(Obj) ((PySliceObject *)(Obj))
+#else
+#define SLICE_CAST(Obj) (Obj)
+#endif
+
 struct RDepListStruct
 {
    pkgCache::DepIterator Iter;
@@ -66,6 +89,59 @@ struct RDepListStruct
    RDepListStruct() {abort();};  // G++ Bug..
 };
 
+/* Return the dependency type given by Item, either as an integer or as
+   its untranslated name. Returns -1 and sets an exception if invalid. */
+static long ParseDepType(PyObject *Item)
+{
+   const int TypeCount = sizeof(UntranslatedDepTypes) / sizeof(*UntranslatedDepTypes);
+   long Type = -1;
+   if (PyString_Check(Item) || PyUnicode_Check(Item))
+   {
+      const char *Name = PyObject_AsString(Item);
+      if (Name == 0)
+	 return -1;
+      for (int J = 1; J != TypeCount; J++)
+	 if (strcmp(UntranslatedDepTypes[J],Name) == 0)
+	    Type = J;
+   }
+   else if (PyInt_Check(Item) || PyLong_Check(Item))
+      Type = PyLong_AsLong(Item);
+
+   if (Type < 1 || Type >= TypeCount)
+   {
+      if (PyErr_Occurred() == 0)
+	 PyErr_SetString(PyExc_ValueError,"Invalid dependency type");
+      return -1;
+   }
+   return Type;
+}
+
+/* Convert a sequence of dependency types into a bit mask. If Types is not
+   given, use Default. */
+static bool ParseDepTypes(PyObject *Types,unsigned long &Mask,
+			  unsigned long Default)
+{
+   if (Types == 0 || Types == Py_None)
+   {
+      Mask = Default;
+      return true;
+   }
+
+   PyObject *Seq = PySequence_Fast(Types,"dep_types must be a sequence");
+   if (Seq == 0)
+      return false;
+   Mask = 0;
+   for (Py_ssize_t I = 0; I != PySequence_Fast_GET_SIZE(Seq); I++)
+   {
+      long Type = ParseDepType(PySequence_Fast_GET_ITEM(Seq,I));
+      if (Type == -1)
+	 break;
+      Mask |= 1UL << Type;
+   }
+   Py_DECREF(Seq);
+   return PyErr_Occurred() == 0;
+}
+
 static PyObject *CreateProvides(PyObject *Owner,pkgCache::PrvIterator I)
 {
    PyObject *List = PyList_New(0);
@@ -73,8 +149,7 @@ static PyObject *CreateProvides(PyObject *Owner,pkgCache::PrvIterator I)
    {
       PyObject *Obj;
       PyObject *Ver;
-      Ver = CppPyObject_NEW<pkgCache::VerIterator>(Owner,&PyVersion_Type,
-							I.OwnerVer());
+      Ver = GetVersionObject(Owner,I.OwnerVer());
       Obj = Py_BuildValue("ssN",I.ParentPkg().Name(),I.ProvideVersion(),
 			  Ver);
       PyList_Append(List,Obj);
@@ -83,6 +158,427 @@ static PyObject *CreateProvides(PyObject *Owner,pkgCache::PrvIterator I)
    return List;
 }
 
+// Cache Tables								/*{{{*/
+// ---------------------------------------------------------------------
+/* Package IDs are handed out sequentially by the cache generator, but the
+   packages themselves are only reachable through the hash table. Walk it
+   once and remember where each ID lives. */
+pkgCache::Package **PkgCacheTables::PackageTable()
+{
+   if (Packages.empty() == true && Cache->HeaderP->PackageCount != 0)
+   {
+      Packages.resize(Cache->HeaderP->PackageCount,0);
+      for (pkgCache::PkgIterator P = Cache->PkgBegin(); P.end() == false; P++)
+	 if (P->ID < Packages.size())
+	    Packages[P->ID] = P;
+   }
+   return Packages.empty() ? 0 : &Packages[0];
+}
+
+pkgCache::Version **PkgCacheTables::VersionTable()
+{
+   if (Versions.empty() == true && Cache->HeaderP->VersionCount != 0)
+   {
+      Versions.resize(Cache->HeaderP->VersionCount,0);
+      for (pkgCache::PkgIterator P = Cache->PkgBegin(); P.end() == false; P++)
+	 for (pkgCache::VerIterator V = P.VersionList(); V.end() == false; V++)
+	    if (V->ID < Versions.size())
+	       Versions[V->ID] = V;
+   }
+   return Versions.empty() ? 0 : &Versions[0];
+}
+
+// Case insensitive FNV-1a hash, matching the name comparison of FindPkg().
+static inline unsigned long NameHash(const char *Name)
+{
+   unsigned long Hash = 2166136261UL;
+   for (; *Name != 0; Name++)
+      Hash = ((Hash ^ tolower((unsigned char)*Name)) * 16777619UL) & 0xFFFFFFFFUL;
+   return Hash;
+}
+
+void PkgCacheTables::BuildNameIndex()
+{
+   if (NameIndex.empty() == false)
+      return;
+
+   // Keep the load factor below one half, so probe sequences stay short.
+   unsigned long Size = 16;
+   while (Size < 2 * (unsigned long)Cache->HeaderP->PackageCount)
+      Size *= 2;
+   NameIndex.resize(Size,0xFFFFFFFF);
+   for (pkgCache::PkgIterator P = Cache->PkgBegin(); P.end() == false; P++)
+   {
+      unsigned long Slot = NameHash(P.Name()) & (Size - 1);
+      while (NameIndex[Slot] != 0xFFFFFFFF)
+	 Slot = (Slot + 1) & (Size - 1);
+      NameIndex[Slot] = P->ID;
+   }
+   PackageTable();
+}
+
+pkgCache::Package *PkgCacheTables::FindPackage(const char *Name)
+{
+   if (NameIndex.empty() == true)
+   {
+      pkgCache::PkgIterator Pkg = Cache->FindPkg(Name);
+      return Pkg.end() ? 0 : (pkgCache::Package *)Pkg;
+   }
+
+   unsigned long Mask = NameIndex.size() - 1;
+   for (unsigned long Slot = NameHash(Name) & Mask;
+	NameIndex[Slot] != 0xFFFFFFFF; Slot = (Slot + 1) & Mask)
+   {
+      pkgCache::Package *Pkg = Packages[NameIndex[Slot]];
+      if (strcasecmp(Cache->StrP + Pkg->Name,Name) == 0)
+	 return Pkg;
+   }
+   return 0;
+}
+
+PkgCacheTables::~PkgCacheTables()
+{
+   for (std::vector<PyObject *>::iterator I = Names.begin(); I != Names.end(); I++)
+      Py_XDECREF(*I);
+   for (std::vector<PyObject *>::iterator I = VerStrs.begin(); I != VerStrs.end(); I++)
+      Py_XDECREF(*I);
+}
+
+/* Return an interned string for Str, creating it on first use and storing
+   it in Table at the position ID. */
+static PyObject *CachedString(std::vector<PyObject *> &Table,
+			      unsigned long Size,unsigned long ID,
+			      const char *Str)
+{
+   if (Table.empty() == true)
+      Table.resize(Size,0);
+   if (ID >= Table.size())
+      return PyString_FromString(Str);
+
+   if (Table[ID] == 0)
+   {
+      PyObject *New = PyString_FromString(Str);
+      if (New == 0)
+	 return 0;
+      PyString_InternInPlace(&New);
+      Table[ID] = New;
+   }
+   Py_INCREF(Table[ID]);
+   return Table[ID];
+}
+
+PyObject *PkgCacheTables::PackageName(pkgCache::PkgIterator const &Pkg)
+{
+   return CachedString(Names,Cache->HeaderP->PackageCount,Pkg->ID,Pkg.Name());
+}
+
+PyObject *PkgCacheTables::VersionString(pkgCache::VerIterator const &Ver)
+{
+   return CachedString(VerStrs,Cache->HeaderP->VersionCount,Ver->ID,
+		       Ver.VerStr());
+}
+
+PkgCacheTables *GetCacheTables(PyObject *Self)
+{
+   PkgCacheData *Data = (PkgCacheData *)Self;
+   if (Data->Tables == 0)
+      Data->Tables = new PkgCacheTables(Data->Object);
+   return Data->Tables;
+}
+
+// Walk the owners of the cache object Obj to find the apt_pkg.Cache.
+static PyObject *FindCache(PyObject *Obj)
+{
+   // Only follow the owners of cache objects, other types may not have one.
+   while (Obj != 0 && PyObject_TypeCheck(Obj,&PyCache_Type) == 0)
+   {
+      if (PyObject_TypeCheck(Obj,&PyPackage_Type) ||
+	  PyObject_TypeCheck(Obj,&PyVersion_Type) ||
+	  PyObject_TypeCheck(Obj,&PyDependency_Type) ||
+	  PyObject_TypeCheck(Obj,&PyDescription_Type) ||
+	  PyObject_TypeCheck(Obj,&PyPackageFile_Type))
+	 Obj = ((CppPyObject<pkgCache::PkgIterator> *)Obj)->Owner;
+      else
+	 return 0;
+   }
+   return Obj;
+}
+
+PkgCacheTables *FindCacheTables(PyObject *Obj)
+{
+   Obj = FindCache(Obj);
+   return Obj == 0 ? 0 : GetCacheTables(Obj);
+}
+
+/* Return the object for It stored in Objects, creating it if there is none
+   yet. The table only holds a borrowed reference. */
+template<typename T>
+static PyObject *GetUniqueObject(PyObject *Cache,PyTypeObject *Type,
+				 std::vector<PyObject *> &Objects,
+				 unsigned long Size,T const &It)
+{
+   if (Objects.empty() == true)
+      Objects.resize(Size,0);
+   if (It.end() == true || It->ID >= Objects.size())
+      return CppPyObject_NEW<T>(Cache,Type,It);
+
+   PyObject *&Obj = Objects[It->ID];
+   if (Obj == 0)
+      Obj = CppPyObject_NEW<T>(Cache,Type,It);
+   else
+      Py_INCREF(Obj);
+   return Obj;
+}
+
+PyObject *GetPackageObject(PyObject *Owner,pkgCache::PkgIterator const &Pkg)
+{
+   PyObject *Cache = FindCache(Owner);
+   if (Cache == 0 || ((PkgCacheData *)Cache)->UniqueObjects == false)
+      return CppPyObject_NEW<pkgCache::PkgIterator>(Owner,&PyPackage_Type,Pkg);
+   return GetUniqueObject(Cache,&PyPackage_Type,
+			  GetCacheTables(Cache)->PackageObjects,
+			  GetCpp<pkgCache *>(Cache)->HeaderP->PackageCount,Pkg);
+}
+
+PyObject *GetVersionObject(PyObject *Owner,pkgCache::VerIterator const &Ver)
+{
+   PyObject *Cache = FindCache(Owner);
+   if (Cache == 0 || ((PkgCacheData *)Cache)->UniqueObjects == false)
+      return CppPyObject_NEW<pkgCache::VerIterator>(Owner,&PyVersion_Type,Ver);
+   return GetUniqueObject(Cache,&PyVersion_Type,
+			  GetCacheTables(Cache)->VersionObjects,
+			  GetCpp<pkgCache *>(Cache)->HeaderP->VersionCount,Ver);
+}
+
+/* Remove the object Self from the table of unique objects, if it is stored
+   there. Called before its owner is released. */
+template<typename T>
+static void ForgetUniqueObject(PyObject *Self,
+			       std::vector<PyObject *> PkgCacheTables::*Member)
+{
+   PyObject *Cache = FindCache(GetOwner<T>(Self));
+   if (Cache == 0 || ((PkgCacheData *)Cache)->Tables == 0)
+      return;
+   std::vector<PyObject *> &Objects = ((PkgCacheData *)Cache)->Tables->*Member;
+   T &It = GetCpp<T>(Self);
+   if (It.end() == false && It->ID < Objects.size() && Objects[It->ID] == Self)
+      Objects[It->ID] = 0;
+}
+
+static void ResetCacheTables(PyObject *Self)
+{
+   PkgCacheData *Data = (PkgCacheData *)Self;
+   delete Data->Tables;
+   Data->Tables = 0;
+}
+									/*}}}*/
+// Cache validity checks						/*{{{*/
+// ---------------------------------------------------------------------
+/* Collect the index files of the sources list, followed by the status
+   files. The status files are allocated for the caller and have to be
+   deleted using FreeIndexFiles(). */
+static bool CollectIndexFiles(pkgSourceList &List,
+			      std::vector<pkgIndexFile *> &Files,
+			      size_t &EndOfSource)
+{
+   if (List.ReadMainList() == false)
+      return false;
+   for (pkgSourceList::const_iterator I = List.begin(); I != List.end(); I++)
+   {
+      std::vector<pkgIndexFile *> *Indexes = (*I)->GetIndexFiles();
+      for (std::vector<pkgIndexFile *>::const_iterator J = Indexes->begin();
+	   J != Indexes->end(); J++)
+	 Files.push_back(*J);
+   }
+   EndOfSource = Files.size();
+   return _system->AddStatusFiles(Files);
+}
+
+static void FreeIndexFiles(std::vector<pkgIndexFile *> &Files,size_t EndOfSource)
+{
+   for (std::vector<pkgIndexFile *>::iterator I = Files.begin() + EndOfSource;
+	I != Files.end(); I++)
+      delete *I;
+}
+
+/* This is the check done by pkgMakeStatusCache() before it reuses a cache:
+   every index file with packages must be in the cache with the same size
+   and modification time, and the cache must not contain other files. The
+   files failing the check are appended to Changed, if given. */
+static bool CacheIsCurrent(pkgCache &Cache,
+			   std::vector<pkgIndexFile *>::const_iterator Start,
+			   std::vector<pkgIndexFile *>::const_iterator End,
+			   std::vector<pkgIndexFile *> *Changed)
+{
+   bool Valid = true;
+   std::vector<bool> Visited(Cache.HeaderP->PackageFileCount,false);
+   for (; Start != End; Start++)
+   {
+      if ((*Start)->HasPackages() == false || (*Start)->Exists() == false)
+	 continue;
+      pkgCache::PkgFileIterator File = (*Start)->FindInCache(Cache);
+      if (File.end() == false)
+      {
+	 Visited[File->ID] = true;
+	 continue;
+      }
+      Valid = false;
+      if (Changed == 0)
+	 break;
+      Changed->push_back(*Start);
+   }
+   for (std::vector<bool>::const_iterator I = Visited.begin(); I != Visited.end(); I++)
+      if (*I == false)
+	 Valid = false;
+   return Valid;
+}
+
+// Like CacheIsCurrent(), but for a cache file which is not open yet.
+static bool CacheFileIsCurrent(std::string const &CacheFile,
+			       std::vector<pkgIndexFile *>::const_iterator Start,
+			       std::vector<pkgIndexFile *>::const_iterator End,
+			       std::vector<pkgIndexFile *> *Changed)
+{
+   if (CacheFile.empty() == false && FileExists(CacheFile) == true)
+   {
+      FileFd CacheF(CacheFile,FileFd::ReadOnly);
+      MMap Map(CacheF,MMap::Public | MMap::ReadOnly);
+      pkgCache Cache(&Map);
+      if (_error->PendingError() == false && Map.Size() != 0)
+	 return CacheIsCurrent(Cache,Start,End,Changed);
+      _error->Discard();
+   }
+   // Without a usable cache, every index file has to be parsed.
+   for (; Changed != 0 && Start != End; Start++)
+      if ((*Start)->HasPackages() == true && (*Start)->Exists() == true)
+	 Changed->push_back(*Start);
+   return false;
+}
+
+/* Determine how much of the caches pkgCacheFile::Open() is going to
+   rebuild, and which index files are the reason for it. Returns NULL if
+   this cannot be determined; errors are not reported, Open() will. The
+   errors already pending are moved out of the way while checking. */
+static PyObject *CacheRebuildStats()
+{
+   SavedErrors Saved;
+   SaveErrors(Saved);
+
+   pkgSourceList List;
+   std::vector<pkgIndexFile *> Files;
+   size_t EndOfSource = 0;
+   if (CollectIndexFiles(List,Files,EndOfSource) == false)
+   {
+      FreeIndexFiles(Files,EndOfSource);
+      RestoreErrors(Saved);
+      return 0;
+   }
+
+   // The source cache covers the sources list, the binary cache adds the
+   // status files.
+   std::vector<pkgIndexFile *> Changed;
+   std::vector<pkgIndexFile *> BinChanged;
+   bool SrcValid = CacheFileIsCurrent(_config->FindFile("Dir::Cache::srcpkgcache"),
+				      Files.begin(),Files.begin() + EndOfSource,
+				      &Changed);
+   bool BinValid = CacheFileIsCurrent(_config->FindFile("Dir::Cache::pkgcache"),
+				      Files.begin(),Files.end(),&BinChanged);
+   for (std::vector<pkgIndexFile *>::const_iterator I = BinChanged.begin();
+	I != BinChanged.end(); I++)
+      if (std::find(Changed.begin(),Changed.end(),*I) == Changed.end())
+	 Changed.push_back(*I);
+
+   unsigned long IndexCount = 0;
+   for (std::vector<pkgIndexFile *>::const_iterator I = Files.begin();
+	I != Files.end(); I++)
+      if ((*I)->HasPackages() == true && (*I)->Exists() == true)
+	 IndexCount++;
+
+   PyObject *ChangedList = PyList_New(0);
+   for (std::vector<pkgIndexFile *>::const_iterator I = Changed.begin();
+	I != Changed.end(); I++)
+   {
+      PyObject *Name = CppPyString((*I)->Describe(true));
+      PyList_Append(ChangedList,Name);
+      Py_DECREF(Name);
+   }
+   FreeIndexFiles(Files,EndOfSource);
+   RestoreErrors(Saved);
+
+   const char *Rebuild = BinValid ? "none" : (SrcValid ? "status" : "full");
+   return Py_BuildValue("{s:b,s:b,s:s,s:k,s:N}",
+			"pkgcache_valid",BinValid,
+			"srcpkgcache_valid",SrcValid,
+			"rebuild",Rebuild,
+			"index_files",IndexCount,
+			"changed_files",ChangedList);
+}
+									/*}}}*/
+// ReadOnlyCacheFile - Map an existing binary cache			/*{{{*/
+// ---------------------------------------------------------------------
+bool ReadOnlyCacheFile::Open(pkgCacheFile &File)
+{
+   MMap *&Map = File.*(&ReadOnlyCacheFile::Map);
+   pkgCache *&Cache = File.*(&ReadOnlyCacheFile::Cache);
+   pkgPolicy *&Policy = File.Policy;
+
+   std::string CacheFile = _config->FindFile("Dir::Cache::pkgcache");
+   if (CacheFile.empty() == true || FileExists(CacheFile) == false)
+      return _error->Error("The package cache file %s does not exist",
+			   CacheFile.c_str());
+
+   FileFd CacheF(CacheFile,FileFd::ReadOnly);
+   if (_error->PendingError() == true)
+      return false;
+   Map = new MMap(CacheF,MMap::Public | MMap::ReadOnly);
+   if (_error->PendingError() == true)
+      return false;
+   Cache = new pkgCache(Map);
+   if (_error->PendingError() == true)
+      return false;
+
+   pkgSourceList List;
+   std::vector<pkgIndexFile *> Files;
+   size_t EndOfSource = 0;
+   bool Res = CollectIndexFiles(List,Files,EndOfSource);
+   bool Valid = Res && CacheIsCurrent(*Cache,Files.begin(),Files.end(),0);
+   FreeIndexFiles(Files,EndOfSource);
+   if (Res == false)
+      return false;
+   if (Valid == false)
+      return _error->Error("The package cache file %s is out of date",
+			   CacheFile.c_str());
+
+   Policy = new pkgPolicy(Cache);
+   if (_error->PendingError() == true || ReadPinFile(*Policy) == false)
+      return false;
+   return true;
+}
+
+pkgDepCache *ReadOnlyCacheFile::GetDepCache(pkgCacheFile &File)
+{
+   pkgCache *Cache = File.*(&ReadOnlyCacheFile::Cache);
+   pkgDepCache *&DCache = File.*(&ReadOnlyCacheFile::DCache);
+   if (Cache == 0)
+   {
+      _error->Error("The cache has been closed");
+      return 0;
+   }
+   if (DCache == 0)
+   {
+      DCache = new pkgDepCache(Cache,File.Policy);
+      if (DCache->Init(0) == false || _error->PendingError() == true)
+      {
+	 delete DCache;
+	 DCache = 0;
+	 // Init() may fail without saying why, make sure there is an error.
+	 if (_error->PendingError() == false)
+	    _error->Error("Unable to create the dependency cache");
+      }
+   }
+   return DCache;
+}
+									/*}}}*/
 // Cache Class								/*{{{*/
 // ---------------------------------------------------------------------
 static PyObject *PkgCacheUpdate(PyObject *Self,PyObject *Args)
@@ -111,6 +607,7 @@ static PyObject *PkgCacheClose(PyObject *Self,PyObject *Args)
                    "because it causes segfaults. Delete the Cache instead.", 1);
    PyObject *CacheFilePy = GetOwner<pkgCache*>(Self);
    pkgCacheFile *Cache = GetCpp<pkgCacheFile*>(CacheFilePy);
+   ResetCacheTables(Self);
    Cache->Close();
 
    Py_INCREF(Py_None);
@@ -130,7 +627,12 @@ static PyObject *PkgCacheOpen(PyObject *Self,PyObject *Args)
    if (PyArg_ParseTuple(Args, "|O", &pyCallbackInst) == 0)
       return 0;
 
-   if(pyCallbackInst != 0) {
+   if (((PkgCacheData *)Self)->ReadOnly == true) {
+      // Map the cache again instead of building it.
+      Cache->Close();
+      if (ReadOnlyCacheFile::Open(*Cache) == false)
+	 return HandleErrors();
+   } else if(pyCallbackInst != 0) {
       PyOpProgress progress;
       progress.setCallbackInst(pyCallbackInst);
       if (Cache->Open(progress,false) == false)
@@ -141,20 +643,781 @@ static PyObject *PkgCacheOpen(PyObject *Self,PyObject *Args)
 	 return HandleErrors();
    }
 
-   //std::cout << "new cache is " << (pkgCache*)(*Cache) << std::endl;
+   //std::cout << "new cache is " << (pkgCache*)(*Cache) << std::endl;
+
+   // update the cache pointer after the cache was rebuild
+   ((CppPyObject<pkgCache*> *)Self)->Object = (pkgCache*)(*Cache);
+   ResetCacheTables(Self);
+
+
+   Py_INCREF(Py_None);
+   return HandleErrors(Py_None);
+}
+#endif
+
+// Cache.export_columns() - Bulk export of package and version data	/*{{{*/
+// ---------------------------------------------------------------------
+/* Each exportable field is described by a function reading it from an
+   iterator. Integer fields are stored in a Column of the given format,
+   string fields (Format 0) are exported as a column of offsets into one
+   shared string blob, in which the strings of each field are contiguous. */
+template<typename Iter> struct ExportField
+{
+   const char *Name;
+   char Format;
+   unsigned long long (*Int)(Iter &);
+   const char *(*Str)(Iter &);
+};
+
+static unsigned long long PkgFieldID(pkgCache::PkgIterator &P) {return P->ID;}
+static const char *PkgFieldName(pkgCache::PkgIterator &P) {return P.Name();}
+static const char *PkgFieldSection(pkgCache::PkgIterator &P) {return P.Section();}
+static unsigned long long PkgFieldSelectedState(pkgCache::PkgIterator &P) {return P->SelectedState;}
+static unsigned long long PkgFieldInstState(pkgCache::PkgIterator &P) {return P->InstState;}
+static unsigned long long PkgFieldCurrentState(pkgCache::PkgIterator &P) {return P->CurrentState;}
+static unsigned long long PkgFieldEssential(pkgCache::PkgIterator &P) {return (P->Flags & pkgCache::Flag::Essential) != 0;}
+static unsigned long long PkgFieldImportant(pkgCache::PkgIterator &P) {return (P->Flags & pkgCache::Flag::Important) != 0;}
+static unsigned long long PkgFieldAuto(pkgCache::PkgIterator &P) {return (P->Flags & pkgCache::Flag::Auto) != 0;}
+static unsigned long long PkgFieldCurrentVer(pkgCache::PkgIterator &P)
+{
+   // 0xFFFFFFFF marks packages which are not installed.
+   return P.CurrentVer().end() ? 0xFFFFFFFFUL : P.CurrentVer()->ID;
+}
+
+static ExportField<pkgCache::PkgIterator> PkgExportFields[] =
+{
+   {"id",'I',PkgFieldID,0},
+   {"name",0,0,PkgFieldName},
+   {"section",0,0,PkgFieldSection},
+   {"selected_state",'B',PkgFieldSelectedState,0},
+   {"inst_state",'B',PkgFieldInstState,0},
+   {"current_state",'B',PkgFieldCurrentState,0},
+   {"essential",'B',PkgFieldEssential,0},
+   {"important",'B',PkgFieldImportant,0},
+   {"auto",'B',PkgFieldAuto,0},
+   {"current_ver",'I',PkgFieldCurrentVer,0},
+   {}
+};
+
+static unsigned long long VerFieldID(pkgCache::VerIterator &V) {return V->ID;}
+static unsigned long long VerFieldPackageID(pkgCache::VerIterator &V) {return V.ParentPkg()->ID;}
+static const char *VerFieldVerStr(pkgCache::VerIterator &V) {return V.VerStr();}
+static const char *VerFieldSection(pkgCache::VerIterator &V) {return V.Section();}
+static const char *VerFieldArch(pkgCache::VerIterator &V) {return V.Arch();}
+static unsigned long long VerFieldSize(pkgCache::VerIterator &V) {return V->Size;}
+static unsigned long long VerFieldInstalledSize(pkgCache::VerIterator &V) {return V->InstalledSize;}
+static unsigned long long VerFieldPriority(pkgCache::VerIterator &V) {return V->Priority;}
+static unsigned long long VerFieldHash(pkgCache::VerIterator &V) {return V->Hash;}
+static unsigned long long VerFieldDownloadable(pkgCache::VerIterator &V) {return V.Downloadable();}
+
+static ExportField<pkgCache::VerIterator> VerExportFields[] =
+{
+   {"id",'I',VerFieldID,0},
+   {"package_id",'I',VerFieldPackageID,0},
+   {"ver_str",0,0,VerFieldVerStr},
+   {"section",0,0,VerFieldSection},
+   {"arch",0,0,VerFieldArch},
+   {"size",'Q',VerFieldSize,0},
+   {"installed_size",'Q',VerFieldInstalledSize,0},
+   {"priority",'B',VerFieldPriority,0},
+   {"hash",'I',VerFieldHash,0},
+   {"downloadable",'B',VerFieldDownloadable,0},
+   {}
+};
+
+template<typename Iter,typename Item>
+static PyObject *ExportColumns(PyObject *Fields,pkgCache &Cache,Item **Table,
+			       size_t Count,ExportField<Iter> *Known)
+{
+   PyObject *Seq = PySequence_Fast(Fields,"fields must be a sequence");
+   if (Seq == 0)
+      return 0;
+
+   // Resolve the names and create one column per field.
+   Py_ssize_t FieldCount = PySequence_Fast_GET_SIZE(Seq);
+   std::vector<ExportField<Iter> *> Defs(FieldCount);
+   std::vector<PyObject *> Columns(FieldCount,(PyObject *)0);
+   PyObject *Result = PyDict_New();
+   if (Result == 0)
+   {
+      Py_DECREF(Seq);
+      return 0;
+   }
+   bool HaveStrings = false;
+   for (Py_ssize_t I = 0; I != FieldCount; I++)
+   {
+      PyObject *Name = PySequence_Fast_GET_ITEM(Seq,I);
+      const char *CName = PyObject_AsString(Name);
+      if (CName == 0)
+	 goto error;
+      ExportField<Iter> *Def = Known;
+      for (; Def->Name != 0 && strcmp(Def->Name,CName) != 0; Def++);
+      if (Def->Name == 0)
+      {
+	 PyErr_Format(PyExc_ValueError,"Unknown field: %s",CName);
+	 goto error;
+      }
+      Defs[I] = Def;
+      if (Def->Str != 0)
+	 HaveStrings = true;
+      // Keep our own reference, the dict drops its one for repeated names.
+      Columns[I] = PyColumn_New(Def->Str != 0 ? 'I' : Def->Format,
+				Def->Str != 0 ? Count + 1 : Count);
+      if (Columns[I] == 0 || PyDict_SetItem(Result,Name,Columns[I]) == -1)
+	 goto error;
+   }
+
+   {
+      // Walk the cache once and fill all columns row by row. Every string
+      // field gets its own buffer, holes in the table are empty strings.
+      std::vector<std::string> FieldStrings(FieldCount);
+      for (size_t Row = 0; Row != Count; Row++)
+      {
+	 if (Table[Row] == 0)
+	 {
+	    for (Py_ssize_t I = 0; I != FieldCount; I++)
+	       if (Defs[I]->Str != 0)
+		  ((unsigned int *)PyColumn_Data(Columns[I]))[Row] = FieldStrings[I].size();
+	    continue;
+	 }
+	 Iter It(Cache,Table[Row]);
+	 for (Py_ssize_t I = 0; I != FieldCount; I++)
+	 {
+	    if (Defs[I]->Str == 0)
+	    {
+	       PyColumn_SetItem(Columns[I],Row,Defs[I]->Int(It));
+	       continue;
+	    }
+	    ((unsigned int *)PyColumn_Data(Columns[I]))[Row] = FieldStrings[I].size();
+	    const char *Str = Defs[I]->Str(It);
+	    if (Str != 0)
+	       FieldStrings[I].append(Str);
+	 }
+      }
+
+      // Concatenate the buffers and make the offsets relative to the blob.
+      std::string Strings;
+      for (Py_ssize_t I = 0; I != FieldCount; I++)
+      {
+	 if (Defs[I]->Str == 0)
+	    continue;
+	 unsigned int *Offsets = (unsigned int *)PyColumn_Data(Columns[I]);
+	 unsigned int Base = Strings.size();
+	 for (size_t Row = 0; Row != Count; Row++)
+	    Offsets[Row] += Base;
+	 Strings.append(FieldStrings[I]);
+	 Offsets[Count] = Strings.size();
+      }
+
+      if (HaveStrings == true)
+      {
+	 PyObject *Blob = PyBytes_FromStringAndSize(Strings.c_str(),Strings.size());
+	 if (Blob == 0 || PyDict_SetItemString(Result,"strings",Blob) == -1)
+	 {
+	    Py_XDECREF(Blob);
+	    goto error;
+	 }
+	 Py_DECREF(Blob);
+      }
+   }
+   for (Py_ssize_t I = 0; I != FieldCount; I++)
+      Py_DECREF(Columns[I]);
+   Py_DECREF(Seq);
+   return Result;
+
+error:
+   for (Py_ssize_t I = 0; I != FieldCount; I++)
+      Py_XDECREF(Columns[I]);
+   Py_DECREF(Seq);
+   Py_DECREF(Result);
+   return 0;
+}
+
+static PyObject *PkgCacheExportColumns(PyObject *Self,PyObject *Args,PyObject *kwds)
+{
+   PyObject *Fields;
+   char Versions = 0;
+   char *kwlist[] = {"fields","versions",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O|b",kwlist,&Fields,&Versions) == 0)
+      return 0;
+
+   pkgCache *Cache = GetCpp<pkgCache *>(Self);
+   PkgCacheTables *Tables = GetCacheTables(Self);
+   if (Versions == true)
+      return ExportColumns(Fields,*Cache,Tables->VersionTable(),
+			   Cache->HeaderP->VersionCount,VerExportFields);
+   return ExportColumns(Fields,*Cache,Tables->PackageTable(),
+			Cache->HeaderP->PackageCount,PkgExportFields);
+}
+
+static char *doc_PkgCacheExportColumns =
+    "export_columns(fields: list[, versions: bool = False]) -> dict\n\n"
+    "Export the given fields of all packages (or, if 'versions' is True,\n"
+    "of all versions) as a dictionary mapping each field name to a Column,\n"
+    "indexed by package or version ID.\n\n"
+    "Package fields: id, name, section, selected_state, inst_state,\n"
+    "current_state, essential, important, auto, current_ver (the ID of the\n"
+    "installed version or 0xFFFFFFFF).\n\n"
+    "Version fields: id, package_id, ver_str, section, arch, size,\n"
+    "installed_size, priority, hash, downloadable.\n\n"
+    "String fields are exported as n+1 offsets into the bytes object stored\n"
+    "under the key 'strings'; the value of row i is strings[off[i]:off[i+1]].";
+									/*}}}*/
+
+// Cache.closure() - Transitive (reverse) dependency closure		/*{{{*/
+// ---------------------------------------------------------------------
+/* Breadth-first walk over the dependency graph, level by level so that
+   the depth can be limited. Dependencies on virtual packages also reach
+   the packages providing them. Only the mmap'd cache is read, so the walk
+   can run without holding the global interpreter lock. */
+struct ClosureWalker
+{
+   pkgCache &Cache;
+   unsigned long Mask;
+   std::vector<bool> Visited;
+   std::vector<pkgCache::Package *> Next;
+   std::vector<unsigned int> Result;
+
+   ClosureWalker(pkgCache &Cache,unsigned long Mask) : Cache(Cache),
+      Mask(Mask), Visited(Cache.HeaderP->PackageCount,false) {};
+
+   void Visit(pkgCache::PkgIterator Pkg)
+   {
+      if (Pkg.end() == true || Pkg->ID >= Visited.size() || Visited[Pkg->ID])
+	 return;
+      Visited[Pkg->ID] = true;
+      Next.push_back((pkgCache::Package *)Pkg);
+      Result.push_back(Pkg->ID);
+   }
+
+   void Forward(pkgCache::PkgIterator Pkg)
+   {
+      for (pkgCache::VerIterator V = Pkg.VersionList(); V.end() == false; V++)
+	 for (pkgCache::DepIterator D = V.DependsList(); D.end() == false; D++)
+	 {
+	    if ((Mask & (1UL << D->Type)) == 0)
+	       continue;
+	    pkgCache::PkgIterator Target = D.TargetPkg();
+	    Visit(Target);
+	    for (pkgCache::PrvIterator P = Target.ProvidesList(); P.end() == false; P++)
+	       Visit(P.OwnerPkg());
+	 }
+   }
+
+   void Reverse(pkgCache::PkgIterator Pkg)
+   {
+      for (pkgCache::DepIterator D = Pkg.RevDependsList(); D.end() == false; D++)
+	 if ((Mask & (1UL << D->Type)) != 0)
+	    Visit(D.ParentPkg());
+      // Packages depending on something this package provides.
+      for (pkgCache::VerIterator V = Pkg.VersionList(); V.end() == false; V++)
+	 for (pkgCache::PrvIterator P = V.ProvidesList(); P.end() == false; P++)
+	    for (pkgCache::DepIterator D = P.ParentPkg().RevDependsList();
+		 D.end() == false; D++)
+	       if ((Mask & (1UL << D->Type)) != 0)
+		  Visit(D.ParentPkg());
+   }
+
+   void Run(bool Backwards,long MaxDepth)
+   {
+      std::vector<pkgCache::Package *> Level;
+      for (long Depth = 0; Next.empty() == false; Depth++)
+      {
+	 if (MaxDepth >= 0 && Depth >= MaxDepth)
+	    break;
+	 Level.swap(Next);
+	 Next.clear();
+	 for (std::vector<pkgCache::Package *>::iterator I = Level.begin();
+	      I != Level.end(); I++)
+	 {
+	    if (Backwards == true)
+	       Reverse(pkgCache::PkgIterator(Cache,*I));
+	    else
+	       Forward(pkgCache::PkgIterator(Cache,*I));
+	 }
+      }
+   }
+};
+
+/* Append the package Item (a Package object or a package ID) of the cache
+   Self to the list of packages Pkgs. */
+static bool ParsePackageRef(PyObject *Self,PyObject *Item,
+			    std::vector<pkgCache::Package *> &Pkgs)
+{
+   pkgCache *Cache = GetCpp<pkgCache *>(Self);
+   if (PyObject_TypeCheck(Item,&PyPackage_Type))
+   {
+      pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(Item);
+      if (Pkg.Cache() != Cache)
+      {
+	 PyErr_SetString(PyExc_ValueError,"Package belongs to another cache");
+	 return false;
+      }
+      Pkgs.push_back(Pkg);
+      return true;
+   }
+   if (PyInt_Check(Item) || PyLong_Check(Item))
+   {
+      long ID = PyLong_AsLong(Item);
+      if (ID < 0 || ID >= (long)Cache->HeaderP->PackageCount)
+      {
+	 if (PyErr_Occurred() == 0)
+	    PyErr_SetString(PyExc_IndexError,"Invalid package ID");
+	 return false;
+      }
+      Pkgs.push_back(GetCacheTables(Self)->PackageTable()[ID]);
+      return true;
+   }
+   PyErr_SetString(PyExc_TypeError,"Expected a Package object or an ID");
+   return false;
+}
+
+bool ParsePackageRefs(PyObject *Self,PyObject *Seq,
+		      std::vector<pkgCache::Package *> &Pkgs)
+{
+   PyObject *Iter = PyObject_GetIter(Seq);
+   if (Iter == 0)
+      return false;
+   PyObject *Item;
+   while ((Item = PyIter_Next(Iter)) != 0)
+   {
+      bool Res = ParsePackageRef(Self,Item,Pkgs);
+      Py_DECREF(Item);
+      if (Res == false)
+	 break;
+   }
+   Py_DECREF(Iter);
+   return PyErr_Occurred() == 0;
+}
+
+static PyObject *PkgCacheClosure(PyObject *Self,PyObject *Args,PyObject *kwds)
+{
+   PyObject *Pkgs;
+   PyObject *Types = 0;
+   char Backwards = 0;
+   PyObject *MaxDepthObj = Py_None;
+   char ReleaseGIL = 0;
+   char *kwlist[] = {"pkgs","dep_types","reverse","max_depth","release_gil",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O|ObOb",kwlist,&Pkgs,&Types,
+				   &Backwards,&MaxDepthObj,&ReleaseGIL) == 0)
+      return 0;
+
+   long MaxDepth = -1;
+   if (MaxDepthObj != Py_None)
+   {
+      MaxDepth = PyInt_AsLong(MaxDepthObj);
+      if (MaxDepth == -1 && PyErr_Occurred())
+	 return 0;
+      if (MaxDepth < 0)
+      {
+	 PyErr_SetString(PyExc_ValueError,"max_depth must not be negative");
+	 return 0;
+      }
+   }
+
+   unsigned long Mask;
+   if (ParseDepTypes(Types,Mask,(1UL << pkgCache::Dep::Depends) |
+		     (1UL << pkgCache::Dep::PreDepends)) == false)
+      return 0;
+
+   std::vector<pkgCache::Package *> Start;
+   if (ParsePackageRefs(Self,Pkgs,Start) == false)
+      return 0;
+
+   pkgCache *Cache = GetCpp<pkgCache *>(Self);
+   ClosureWalker Walker(*Cache,Mask);
+   for (std::vector<pkgCache::Package *>::iterator I = Start.begin();
+	I != Start.end(); I++)
+      Walker.Visit(pkgCache::PkgIterator(*Cache,*I));
+
+   if (ReleaseGIL == true)
+   {
+      Py_BEGIN_ALLOW_THREADS
+      Walker.Run(Backwards,MaxDepth);
+      Py_END_ALLOW_THREADS
+   }
+   else
+      Walker.Run(Backwards,MaxDepth);
+
+   PyObject *Result = PyColumn_New('I',Walker.Result.size());
+   if (Result != 0 && Walker.Result.empty() == false)
+      memcpy(PyColumn_Data(Result),&Walker.Result[0],
+	     Walker.Result.size() * sizeof(unsigned int));
+   return Result;
+}
+
+static char *doc_PkgCacheClosure =
+    "closure(pkgs[, dep_types, reverse=False, max_depth=None,\n"
+    "        release_gil=False]) -> Column\n\n"
+    "Return the IDs of all packages reachable from the packages in 'pkgs'\n"
+    "(Package objects or package IDs) by following dependencies of the\n"
+    "types in 'dep_types' (dependency type numbers or names like 'Depends';\n"
+    "default: Depends and PreDepends) in breadth-first order, starting\n"
+    "with the given packages.\n\n"
+    "If 'reverse' is True, follow reverse dependencies instead. Dependencies\n"
+    "on virtual packages are resolved to the packages providing them. If\n"
+    "'max_depth' is given, stop after that many steps. If 'release_gil' is\n"
+    "True, other Python threads may run during the walk.";
+									/*}}}*/
+
+// Cache.lookup_many() - Batch lookup of packages by name		/*{{{*/
+// ---------------------------------------------------------------------
+static PyObject *PkgCacheLookupMany(PyObject *Self,PyObject *Args,PyObject *kwds)
+{
+   PyObject *Names;
+   char IDs = 0;
+   char *kwlist[] = {"names","ids",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O|b",kwlist,&Names,&IDs) == 0)
+      return 0;
+
+   PyObject *Seq = PySequence_Fast(Names,"names must be a sequence");
+   if (Seq == 0)
+      return 0;
+
+   // Resolve all names first, so no Python objects are created in between.
+   PkgCacheTables *Tables = GetCacheTables(Self);
+   Py_ssize_t Count = PySequence_Fast_GET_SIZE(Seq);
+   std::vector<pkgCache::Package *> Pkgs(Count,(pkgCache::Package *)0);
+   for (Py_ssize_t I = 0; I != Count; I++)
+   {
+      const char *Name = PyObject_AsString(PySequence_Fast_GET_ITEM(Seq,I));
+      if (Name == 0)
+      {
+	 Py_DECREF(Seq);
+	 return 0;
+      }
+      Pkgs[I] = Tables->FindPackage(Name);
+   }
+   Py_DECREF(Seq);
+
+   if (IDs == true)
+   {
+      PyObject *Result = PyColumn_New('I',Count);
+      if (Result == 0)
+	 return 0;
+      unsigned int *Data = (unsigned int *)PyColumn_Data(Result);
+      for (Py_ssize_t I = 0; I != Count; I++)
+	 Data[I] = Pkgs[I] == 0 ? 0xFFFFFFFF : Pkgs[I]->ID;
+      return Result;
+   }
+
+   pkgCache *Cache = GetCpp<pkgCache *>(Self);
+   PyObject *Result = PyList_New(Count);
+   for (Py_ssize_t I = 0; I != Count; I++)
+   {
+      PyObject *Obj;
+      if (Pkgs[I] == 0)
+      {
+	 Py_INCREF(Py_None);
+	 Obj = Py_None;
+      }
+      else
+	 Obj = GetPackageObject(Self,pkgCache::PkgIterator(*Cache,Pkgs[I]));
+      PyList_SET_ITEM(Result,I,Obj);
+   }
+   return Result;
+}
+
+static char *doc_PkgCacheLookupMany =
+    "lookup_many(names[, ids=False]) -> list\n\n"
+    "Look up the packages with the given names and return a list of\n"
+    "Package objects, with None for names not in the cache. If 'ids' is\n"
+    "True, return a Column of package IDs instead, using 0xFFFFFFFF for\n"
+    "unknown names.";
+
+static PyObject *PkgCacheBuildNameIndex(PyObject *Self,PyObject *Args)
+{
+   GetCacheTables(Self)->BuildNameIndex();
+   Py_INCREF(Py_None);
+   return Py_None;
+}
+
+static char *doc_PkgCacheBuildNameIndex =
+    "build_name_index()\n\n"
+    "Build an in-memory hash index of all package names, used by mapping\n"
+    "access and lookup_many() from now on. This speeds up repeated\n"
+    "lookups of many names at the cost of a few bytes per package.";
+									/*}}}*/
+
+// Cache.select() - Parallel filtering of packages and versions	/*{{{*/
+// ---------------------------------------------------------------------
+/* A predicate compares one string field of a package or version with a
+   value. All predicates of a query must match. The rows are split into
+   contiguous chunks which are checked by worker threads while the global
+   interpreter lock is released; the cache is only read. */
+struct SelectPredicate
+{
+   enum {Name,Section,Arch,VerStr} Field;
+   enum {Equal,NotEqual,FnMatch,Regex} Op;
+   std::string Value;
+   regex_t Pattern;
+
+   bool Match(const char *Str) const
+   {
+      if (Str == 0)
+	 Str = "";
+      switch (Op)
+      {
+	 case Equal: return Value == Str;
+	 case NotEqual: return Value != Str;
+	 case FnMatch: return fnmatch(Value.c_str(),Str,0) == 0;
+	 case Regex: return regexec(&Pattern,Str,0,0,0) == 0;
+      }
+      return false;
+   }
+
+   bool Match(pkgCache::VerIterator Ver) const
+   {
+      switch (Field)
+      {
+	 case Name: return Match(Ver.ParentPkg().Name());
+	 case Section: return Match(Ver.Section());
+	 case Arch: return Match(Ver.Arch());
+	 case VerStr: return Match(Ver.VerStr());
+      }
+      return false;
+   }
+
+   bool Match(pkgCache::PkgIterator Pkg) const
+   {
+      switch (Field)
+      {
+	 case Name: return Match(Pkg.Name());
+	 case Section: return Match(Pkg.Section());
+	 default:
+	    // Version fields match if any version of the package matches.
+	    for (pkgCache::VerIterator V = Pkg.VersionList(); V.end() == false; V++)
+	       if (Match(V) == true)
+		  return true;
+	    return false;
+      }
+   }
+};
+
+struct SelectQuery
+{
+   pkgCache *Cache;
+   std::vector<SelectPredicate *> Predicates;
+   bool Versions;
+   void **Table;
+   std::vector<char> Matches;
+
+   ~SelectQuery()
+   {
+      for (std::vector<SelectPredicate *>::iterator I = Predicates.begin();
+	   I != Predicates.end(); I++)
+      {
+	 if ((*I)->Op == SelectPredicate::Regex)
+	    regfree(&(*I)->Pattern);
+	 delete *I;
+      }
+   }
+
+   bool Match(void *Row) const
+   {
+      for (std::vector<SelectPredicate *>::const_iterator I = Predicates.begin();
+	   I != Predicates.end(); I++)
+      {
+	 bool Res;
+	 if (Versions == true)
+	    Res = (*I)->Match(pkgCache::VerIterator(*Cache,(pkgCache::Version *)Row));
+	 else
+	    Res = (*I)->Match(pkgCache::PkgIterator(*Cache,(pkgCache::Package *)Row));
+	 if (Res == false)
+	    return false;
+      }
+      return true;
+   }
+
+   void Run(size_t Begin,size_t End)
+   {
+      for (size_t I = Begin; I != End; I++)
+	 Matches[I] = Table[I] != 0 && Match(Table[I]);
+   }
+};
+
+struct SelectChunk
+{
+   SelectQuery *Query;
+   size_t Begin;
+   size_t End;
+};
+
+static void *SelectWorker(void *Arg)
+{
+   SelectChunk *Chunk = (SelectChunk *)Arg;
+   Chunk->Query->Run(Chunk->Begin,Chunk->End);
+   return 0;
+}
+
+/* Parse one (field, operator, value) tuple. */
+static SelectPredicate *ParseSelectPredicate(PyObject *Spec)
+{
+   const char *Field;
+   const char *Op;
+   const char *Value;
+   if (PyArg_ParseTuple(Spec,"sss;predicates must be (field, op, value) tuples",
+			&Field,&Op,&Value) == 0)
+      return 0;
+
+   SelectPredicate *Pred = new SelectPredicate;
+   Pred->Value = Value;
+   if (strcmp(Field,"name") == 0)
+      Pred->Field = SelectPredicate::Name;
+   else if (strcmp(Field,"section") == 0)
+      Pred->Field = SelectPredicate::Section;
+   else if (strcmp(Field,"arch") == 0)
+      Pred->Field = SelectPredicate::Arch;
+   else if (strcmp(Field,"ver_str") == 0)
+      Pred->Field = SelectPredicate::VerStr;
+   else
+   {
+      PyErr_Format(PyExc_ValueError,"Unknown field: %s",Field);
+      delete Pred;
+      return 0;
+   }
+
+   if (strcmp(Op,"==") == 0)
+      Pred->Op = SelectPredicate::Equal;
+   else if (strcmp(Op,"!=") == 0)
+      Pred->Op = SelectPredicate::NotEqual;
+   else if (strcmp(Op,"fnmatch") == 0)
+      Pred->Op = SelectPredicate::FnMatch;
+   else if (strcmp(Op,"regex") == 0)
+   {
+      Pred->Op = SelectPredicate::Regex;
+      int Res = regcomp(&Pred->Pattern,Value,REG_EXTENDED | REG_NOSUB);
+      if (Res != 0)
+      {
+	 char Error[300];
+	 regerror(Res,&Pred->Pattern,Error,sizeof(Error));
+	 PyErr_Format(PyExc_ValueError,"Invalid regular expression: %s",Error);
+	 delete Pred;
+	 return 0;
+      }
+   }
+   else
+   {
+      PyErr_Format(PyExc_ValueError,"Unknown operator: %s",Op);
+      delete Pred;
+      return 0;
+   }
+   return Pred;
+}
+
+static PyObject *PkgCacheSelect(PyObject *Self,PyObject *Args,PyObject *kwds)
+{
+   PyObject *Spec;
+   char Versions = 0;
+   int Threads = 0;
+   char *kwlist[] = {"predicates","versions","threads",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O|bi",kwlist,&Spec,&Versions,
+				   &Threads) == 0)
+      return 0;
 
-   // update the cache pointer after the cache was rebuild
-   ((CppPyObject<pkgCache*> *)Self)->Object = (pkgCache*)(*Cache);
+   SelectQuery Query;
+   Query.Cache = GetCpp<pkgCache *>(Self);
+   Query.Versions = Versions;
 
+   PyObject *Seq = PySequence_Fast(Spec,"predicates must be a sequence");
+   if (Seq == 0)
+      return 0;
+   for (Py_ssize_t I = 0; I != PySequence_Fast_GET_SIZE(Seq); I++)
+   {
+      SelectPredicate *Pred = ParseSelectPredicate(PySequence_Fast_GET_ITEM(Seq,I));
+      if (Pred == 0)
+      {
+	 Py_DECREF(Seq);
+	 return 0;
+      }
+      Query.Predicates.push_back(Pred);
+   }
+   Py_DECREF(Seq);
 
-   Py_INCREF(Py_None);
-   return HandleErrors(Py_None);
-}
-#endif
+   // Build the ID tables while we still hold the lock.
+   PkgCacheTables *Tables = GetCacheTables(Self);
+   size_t Count;
+   if (Versions == true)
+   {
+      Query.Table = (void **)Tables->VersionTable();
+      Count = Query.Cache->HeaderP->VersionCount;
+   }
+   else
+   {
+      Query.Table = (void **)Tables->PackageTable();
+      Count = Query.Cache->HeaderP->PackageCount;
+   }
+   Query.Matches.resize(Count,0);
+
+   if (Threads <= 0)
+      Threads = sysconf(_SC_NPROCESSORS_ONLN);
+   if (Threads <= 0)
+      Threads = 1;
+   // Small chunks are not worth a thread.
+   if ((size_t)Threads > Count / 1024 + 1)
+      Threads = Count / 1024 + 1;
+
+   Py_BEGIN_ALLOW_THREADS
+   std::vector<SelectChunk> Chunks(Threads);
+   std::vector<pthread_t> Workers(Threads);
+   std::vector<bool> Started(Threads,false);
+   for (int I = 0; I != Threads; I++)
+   {
+      Chunks[I].Query = &Query;
+      Chunks[I].Begin = Count * I / Threads;
+      Chunks[I].End = Count * (I + 1) / Threads;
+      // Run the first chunk in this thread, and any chunk whose thread
+      // could not be started.
+      if (I != 0 && pthread_create(&Workers[I],0,SelectWorker,&Chunks[I]) == 0)
+	 Started[I] = true;
+   }
+   for (int I = 0; I != Threads; I++)
+      if (Started[I] == false)
+	 SelectWorker(&Chunks[I]);
+   for (int I = 0; I != Threads; I++)
+      if (Started[I] == true)
+	 pthread_join(Workers[I],0);
+   Py_END_ALLOW_THREADS
+
+   size_t Found = 0;
+   for (size_t I = 0; I != Count; I++)
+      Found += Query.Matches[I];
+   PyObject *Result = PyColumn_New('I',Found);
+   if (Result == 0)
+      return 0;
+   unsigned int *Data = (unsigned int *)PyColumn_Data(Result);
+   for (size_t I = 0; I != Count; I++)
+      if (Query.Matches[I] != 0)
+	 *Data++ = I;
+   return Result;
+}
+
+static char *doc_PkgCacheSelect =
+    "select(predicates[, versions=False, threads=0]) -> Column\n\n"
+    "Return the IDs of all packages (or versions, if 'versions' is True)\n"
+    "matching all the given predicates, in ascending order.\n\n"
+    "Each predicate is a tuple (field, operator, value). The fields are\n"
+    "'name', 'section', 'arch' and 'ver_str'; the operators are '==',\n"
+    "'!=', 'fnmatch' (shell patterns) and 'regex' (POSIX extended regular\n"
+    "expressions). When selecting packages, 'arch' and 'ver_str' match if\n"
+    "any version of the package matches.\n\n"
+    "The search runs on 'threads' threads (default: one per CPU) without\n"
+    "holding the global interpreter lock.";
+									/*}}}*/
 
 static PyMethodDef PkgCacheMethods[] =
 {
    {"update",PkgCacheUpdate,METH_VARARGS,"Update the cache"},
+   {"build_name_index",PkgCacheBuildNameIndex,METH_NOARGS,
+    doc_PkgCacheBuildNameIndex},
+   {"closure",(PyCFunction)PkgCacheClosure,METH_VARARGS|METH_KEYWORDS,
+    doc_PkgCacheClosure},
+   {"export_columns",(PyCFunction)PkgCacheExportColumns,METH_VARARGS|METH_KEYWORDS,
+    doc_PkgCacheExportColumns},
+   {"lookup_many",(PyCFunction)PkgCacheLookupMany,METH_VARARGS|METH_KEYWORDS,
+    doc_PkgCacheLookupMany},
+   {"select",(PyCFunction)PkgCacheSelect,METH_VARARGS|METH_KEYWORDS,
+    doc_PkgCacheSelect},
 #ifdef COMPAT_0_7
    {"Open", PkgCacheOpen, METH_VARARGS,"Open the cache"},
    {"Close", PkgCacheClose, METH_VARARGS,"Close the cache"},
@@ -163,8 +1426,7 @@ static PyMethodDef PkgCacheMethods[] =
 };
 
 static PyObject *PkgCacheGetPackages(PyObject *Self, void*) {
-   pkgCache *Cache = GetCpp<pkgCache *>(Self);
-   return CppPyObject_NEW<PkgListStruct>(Self,&PyPackageList_Type,Cache->PkgBegin());
+   return CppPyObject_NEW<PkgListStruct>(Self,&PyPackageList_Type);
 }
 
 static PyObject *PkgCacheGetPackageCount(PyObject *Self, void*) {
@@ -209,6 +1471,14 @@ static PyObject *PkgCacheGetFileList(PyObject *Self, void*) {
    return List;
 }
 
+static PyObject *PkgCacheGetRebuildStats(PyObject *Self, void*) {
+   PyObject *Stats = ((PkgCacheData *)Self)->RebuildStats;
+   if (Stats == 0)
+      Stats = Py_None;
+   Py_INCREF(Stats);
+   return Stats;
+}
+
 static PyGetSetDef PkgCacheGetSet[] = {
    {"depends_count",PkgCacheGetDependsCount},
    {"file_list",PkgCacheGetFileList},
@@ -216,6 +1486,7 @@ static PyGetSetDef PkgCacheGetSet[] = {
    {"package_file_count",PkgCacheGetPackageFileCount},
    {"packages",PkgCacheGetPackages},
    {"provides_count",PkgCacheGetProvidesCount},
+   {"rebuild_stats",PkgCacheGetRebuildStats},
    {"ver_file_count",PkgCacheGetVerFileCount},
    {"version_count",PkgCacheGetVersionCount},
    {}
@@ -235,14 +1506,14 @@ static PyObject *CacheMapOp(PyObject *Self,PyObject *Arg)
 
 
    // Search for the package
-   pkgCache::PkgIterator Pkg = Cache->FindPkg(Name);
-   if (Pkg.end() == true)
+   pkgCache::Package *Pkg = GetCacheTables(Self)->FindPackage(Name);
+   if (Pkg == 0)
    {
       PyErr_SetString(PyExc_KeyError,Name);
       return 0;
    }
 
-   return CppPyObject_NEW<pkgCache::PkgIterator>(Self,&PyPackage_Type,Pkg);
+   return GetPackageObject(Self,pkgCache::PkgIterator(*Cache,Pkg));
 }
 
 // Check whether the cache contains a package with a given name.
@@ -252,16 +1523,21 @@ static int CacheContains(PyObject *Self,PyObject *Arg)
    const char *Name = PyObject_AsString(Arg);
    if (Name == NULL)
       return 0;
-   return (GetCpp<pkgCache *>(Self)->FindPkg(Name).end() == false);
+   return GetCacheTables(Self)->FindPackage(Name) != 0;
 }
 
 static PyObject *PkgCacheNew(PyTypeObject *type,PyObject *Args,PyObject *kwds)
 {
    PyObject *pyCallbackInst = 0;
-   char *kwlist[] = {"progress", 0};
-
-   if (PyArg_ParseTupleAndKeywords(Args, kwds, "|O", kwlist,
-                                   &pyCallbackInst) == 0)
+   char UniqueObjects = 0;
+   char ReadOnly = 0;
+   char WithStats = 0;
+   char *kwlist[] = {"progress", "unique_objects", "readonly_mmap",
+                     "rebuild_stats", 0};
+
+   if (PyArg_ParseTupleAndKeywords(Args, kwds, "|Obbb", kwlist,
+                                   &pyCallbackInst, &UniqueObjects,
+                                   &ReadOnly, &WithStats) == 0)
       return 0;
 
     if (_system == 0) {
@@ -269,9 +1545,27 @@ static PyObject *PkgCacheNew(PyTypeObject *type,PyObject *Args,PyObject *kwds)
         return 0;
     }
 
-   pkgCacheFile *Cache = new pkgCacheFile();
+   pkgCacheFile *Cache;
+   PyObject *Stats = 0;
+   struct timeval Start;
+   gettimeofday(&Start,0);
+
+   if (ReadOnly == true && WithStats == true) {
+      // A read-only cache is never rebuilt, there is nothing to report.
+      PyErr_SetString(PyExc_ValueError,
+                      "readonly_mmap and rebuild_stats cannot be combined");
+      return 0;
+   }
 
-   if(pyCallbackInst != 0) {
+   if (ReadOnly == true) {
+      Cache = new pkgCacheFile();
+      if (ReadOnlyCacheFile::Open(*Cache) == false) {
+         delete Cache;
+         return HandleErrors();
+      }
+   }
+   else if(pyCallbackInst != 0) {
+      Cache = new pkgCacheFile();
       // sanity check for the progress object, see #497049
       if (PyObject_HasAttrString(pyCallbackInst, "done") != true) {
         PyErr_SetString(PyExc_ValueError,
@@ -283,23 +1577,44 @@ static PyObject *PkgCacheNew(PyTypeObject *type,PyObject *Args,PyObject *kwds)
                         "OpProgress object must implement update()");
         return 0;
       }
+      if (WithStats == true)
+         Stats = CacheRebuildStats();
       PyOpProgress progress;
       progress.setCallbackInst(pyCallbackInst);
-      if (Cache->Open(progress,false) == false)
+      if (Cache->Open(progress,false) == false) {
+         Py_XDECREF(Stats);
          return HandleErrors();
+      }
    }
    else {
+      Cache = new pkgCacheFile();
+      if (WithStats == true)
+         Stats = CacheRebuildStats();
       OpTextProgress Prog;
-      if (Cache->Open(Prog,false) == false)
-	     return HandleErrors();
+      if (Cache->Open(Prog,false) == false) {
+         Py_XDECREF(Stats);
+         return HandleErrors();
+      }
    }
 
    CppPyObject<pkgCacheFile*> *CacheFileObj =
 	   CppPyObject_NEW<pkgCacheFile*>(0,&PyCacheFile_Type, Cache);
 
-   CppPyObject<pkgCache *> *CacheObj =
-	   CppPyObject_NEW<pkgCache *>(CacheFileObj,type,
-					    (pkgCache *)(*Cache));
+   PkgCacheData *CacheObj =
+	   (PkgCacheData *)CppPyObject_NEW<pkgCache *>(CacheFileObj,type,
+							(pkgCache *)(*Cache));
+   CacheObj->Tables = 0;
+   CacheObj->UniqueObjects = UniqueObjects;
+   CacheObj->RebuildStats = Stats;
+   CacheObj->ReadOnly = ReadOnly;
+   if (Stats != 0) {
+      struct timeval End;
+      gettimeofday(&End,0);
+      PyObject *Time = Py_BuildValue("d",(End.tv_sec - Start.tv_sec) +
+                                     (End.tv_usec - Start.tv_usec) / 1000000.0);
+      PyDict_SetItemString(Stats,"open_time",Time);
+      Py_DECREF(Time);
+   }
 
    // Do not delete the pointer to the pkgCache, it is managed by pkgCacheFile.
    CacheObj->NoDelete = true;
@@ -312,12 +1627,29 @@ static Py_ssize_t CacheMapLen(PyObject *Self)
     return GetCpp<pkgCache*>(Self)->HeaderP->PackageCount;
 }
 
-static char *doc_PkgCache = "Cache([progress]) -> Cache() object.\n\n"
+static void PkgCacheDealloc(PyObject *Self)
+{
+   ResetCacheTables(Self);
+   Py_CLEAR(((PkgCacheData *)Self)->RebuildStats);
+   CppDeallocPtr<pkgCache *>(Self);
+}
+
+static char *doc_PkgCache = "Cache([progress, unique_objects, readonly_mmap, rebuild_stats]) -> Cache() object.\n\n"
     "The cache provides access to the packages and other stuff.\n\n"
     "The optional parameter *progress* can be used to specify an \n"
     "apt.progress.OpProgress() object (or similar) which displays\n"
     "the opening progress. If not specified, the progress is\n"
     "displayed in simple text form.\n\n"
+    "If *unique_objects* is True, each package and version is represented\n"
+    "by at most one Package or Version object at any time, so the same\n"
+    "object is returned for the same package and 'is' can be used to\n"
+    "compare them.\n\n"
+    "If *readonly_mmap* is True, the existing binary cache is mapped\n"
+    "read-only and shared between processes, without building it or\n"
+    "showing progress. A SystemError is raised if it is out of date.\n\n"
+    "If *rebuild_stats* is True, the index files are checked against the\n"
+    "cache files before opening, see the rebuild_stats attribute. It\n"
+    "cannot be combined with *readonly_mmap*.\n\n"
     "The cache can be used like a mapping of package names to Package\n"
     "objects.";
 static PySequenceMethods CacheSeq = {0,0,0,0,0,0,0,CacheContains,0,0};
@@ -326,10 +1658,10 @@ PyTypeObject PyCache_Type =
 {
    PyVarObject_HEAD_INIT(&PyType_Type, 0)
    "apt_pkg.Cache",                     // tp_name
-   sizeof(CppPyObject<pkgCache *>),   // tp_basicsize
+   sizeof(PkgCacheData),                // tp_basicsize
    0,                                   // tp_itemsize
    // Methods
-   CppDeallocPtr<pkgCache *>,      // tp_dealloc
+   PkgCacheDealloc,                     // tp_dealloc
    0,                                   // tp_print
    0,                                   // tp_getattr
    0,                                   // tp_setattr
@@ -396,39 +1728,76 @@ PyTypeObject PyCacheFile_Type =
 									/*}}}*/
 // Package List Class							/*{{{*/
 // ---------------------------------------------------------------------
+/* The list is ordered by package ID, i.e. packages[i].id == i. All lookups
+   go through the ID table of the cache, so any access pattern costs O(1)
+   per package. */
 static Py_ssize_t PkgListLen(PyObject *Self)
 {
-   return GetCpp<PkgListStruct>(Self).Iter.Cache()->HeaderP->PackageCount;
+   return GetCpp<pkgCache *>(GetOwner<PkgListStruct>(Self))->HeaderP->PackageCount;
 }
 
 static PyObject *PkgListItem(PyObject *iSelf,Py_ssize_t Index)
 {
-   PkgListStruct &Self = GetCpp<PkgListStruct>(iSelf);
-   if (Index < 0 || (unsigned)Index >= Self.Iter.Cache()->HeaderP->PackageCount)
+   PyObject *CacheObj = GetOwner<PkgListStruct>(iSelf);
+   pkgCache *Cache = GetCpp<pkgCache *>(CacheObj);
+   if (Index < 0 || (unsigned)Index >= Cache->HeaderP->PackageCount)
    {
       PyErr_SetNone(PyExc_IndexError);
       return 0;
    }
 
-   if ((unsigned)Index < Self.LastIndex)
+   pkgCache::Package *Pkg = GetCacheTables(CacheObj)->PackageTable()[Index];
+   if (Pkg == 0)
    {
-      Self.LastIndex = 0;
-      Self.Iter = Self.Iter.Cache()->PkgBegin();
+      PyErr_SetNone(PyExc_IndexError);
+      return 0;
    }
+   return GetPackageObject(CacheObj,pkgCache::PkgIterator(*Cache,Pkg));
+}
 
-   while ((unsigned)Index > Self.LastIndex)
+static PyObject *PkgListSubscript(PyObject *Self,PyObject *Arg)
+{
+   Py_ssize_t Len = PkgListLen(Self);
+
+   if (PySlice_Check(Arg))
    {
-      Self.LastIndex++;
-      Self.Iter++;
-      if (Self.Iter.end() == true)
-      {
-	 PyErr_SetNone(PyExc_IndexError);
+      Py_ssize_t Start, Stop, Step, SliceLen;
+      if (PySlice_GetIndicesEx(SLICE_CAST(Arg),Len,&Start,&Stop,&Step,
+			       &SliceLen) < 0)
 	 return 0;
+
+      PyObject *List = PyList_New(SliceLen);
+      for (Py_ssize_t I = 0, Index = Start; I < SliceLen; I++, Index += Step)
+      {
+	 PyObject *Obj = PkgListItem(Self,Index);
+	 if (Obj == 0)
+	 {
+	    Py_DECREF(List);
+	    return 0;
+	 }
+	 PyList_SET_ITEM(List,I,Obj);
       }
+      return List;
+   }
+
+   if (PyInt_Check(Arg) || PyLong_Check(Arg))
+   {
+      long Index = PyInt_AsLong(Arg);
+      if (Index == -1 && PyErr_Occurred())
+	 return 0;
+      if (Index < 0)
+	 Index += Len;
+      return PkgListItem(Self,Index);
    }
 
-   return CppPyObject_NEW<pkgCache::PkgIterator>(GetOwner<PkgListStruct>(iSelf),&PyPackage_Type,
-						      Self.Iter);
+   PyErr_SetString(PyExc_TypeError,"Indices must be integers or slices.");
+   return 0;
+}
+
+static PyObject *PkgListIter(PyObject *Self)
+{
+   return CppPyObject_NEW<PkgListIterStruct>(GetOwner<PkgListStruct>(Self),
+					     &PyPackageListIterator_Type);
 }
 
 static PySequenceMethods PkgListSeq =
@@ -442,6 +1811,11 @@ static PySequenceMethods PkgListSeq =
    0                 // assign slice
 };
 
+static PyMappingMethods PkgListMap = {PkgListLen,PkgListSubscript,0};
+
+static char *doc_PkgList = "A sequence of all Package objects in the cache.\n\n"
+    "The packages are ordered by their ID, so packages[i].id == i. Indexing\n"
+    "and slicing are O(1) per package.";
 PyTypeObject PyPackageList_Type =
 {
    PyVarObject_HEAD_INIT(&PyType_Type, 0)
@@ -457,7 +1831,7 @@ PyTypeObject PyPackageList_Type =
    0,                                   // tp_repr
    0,                                   // tp_as_number
    &PkgListSeq,                         // tp_as_sequence
-   0,			                // tp_as_mapping
+   &PkgListMap,		                // tp_as_mapping
    0,                                   // tp_hash
    0,                                   // tp_call
    0,                                   // tp_str
@@ -465,10 +1839,66 @@ PyTypeObject PyPackageList_Type =
    0,                                   // tp_setattro
    0,                                   // tp_as_buffer
    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, // tp_flags
-   0,                                   // tp_doc
+   doc_PkgList,                         // tp_doc
    CppTraverse<PkgListStruct>,     // tp_traverse
    CppClear<PkgListStruct>,        // tp_clear
+   0,                                   // tp_richcompare
+   0,                                   // tp_weaklistoffset
+   PkgListIter,                         // tp_iter
+};
+
+// Package List Iterator Class						/*{{{*/
+// ---------------------------------------------------------------------
+static PyObject *PkgListIterNext(PyObject *iSelf)
+{
+   PkgListIterStruct &Self = GetCpp<PkgListIterStruct>(iSelf);
+   PyObject *CacheObj = GetOwner<PkgListIterStruct>(iSelf);
+   pkgCache *Cache = GetCpp<pkgCache *>(CacheObj);
+   pkgCache::Package **Table = GetCacheTables(CacheObj)->PackageTable();
+
+   // Skip holes, which only exist if the cache is inconsistent.
+   for (; Self.Pos < Cache->HeaderP->PackageCount; Self.Pos++)
+   {
+      if (Table[Self.Pos] == 0)
+	 continue;
+      return GetPackageObject(CacheObj,
+			      pkgCache::PkgIterator(*Cache,Table[Self.Pos++]));
+   }
+   return 0;
+}
+
+PyTypeObject PyPackageListIterator_Type =
+{
+   PyVarObject_HEAD_INIT(&PyType_Type, 0)
+   "apt_pkg.PackageListIterator",       // tp_name
+   sizeof(CppPyObject<PkgListIterStruct>), // tp_basicsize
+   0,                                   // tp_itemsize
+   // Methods
+   CppDealloc<PkgListIterStruct>,       // tp_dealloc
+   0,                                   // tp_print
+   0,                                   // tp_getattr
+   0,                                   // tp_setattr
+   0,                                   // tp_compare
+   0,                                   // tp_repr
+   0,                                   // tp_as_number
+   0,                                   // tp_as_sequence
+   0,		                        // tp_as_mapping
+   0,                                   // tp_hash
+   0,                                   // tp_call
+   0,                                   // tp_str
+   0,                                   // tp_getattro
+   0,                                   // tp_setattro
+   0,                                   // tp_as_buffer
+   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, // tp_flags
+   "An iterator over the packages of a PackageList, in ID order.", // tp_doc
+   CppTraverse<PkgListIterStruct>,      // tp_traverse
+   CppClear<PkgListIterStruct>,         // tp_clear
+   0,                                   // tp_richcompare
+   0,                                   // tp_weaklistoffset
+   PyObject_SelfIter,                   // tp_iter
+   PkgListIterNext,                     // tp_iternext
 };
+									/*}}}*/
 
 #define Owner (GetOwner<pkgCache::PkgIterator>(Self))
 #define MkGet(PyFunc,Ret) static PyObject *PyFunc(PyObject *Self,void*) \
@@ -477,7 +1907,15 @@ PyTypeObject PyPackageList_Type =
     return Ret; \
 }
 
-MkGet(PackageGetName,PyString_FromString(Pkg.Name()))
+static PyObject *PackageGetName(PyObject *Self,void*)
+{
+   pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(Self);
+   PkgCacheTables *Tables = FindCacheTables(GetOwner<pkgCache::PkgIterator>(Self));
+   if (Tables == 0)
+      return PyString_FromString(Pkg.Name());
+   return Tables->PackageName(Pkg);
+}
+
 MkGet(PackageGetSection,Safe_FromString(Pkg.Section()))
 MkGet(PackageGetRevDependsList,CppPyObject_NEW<RDepListStruct>(Owner,
                                &PyDependencyList_Type, Pkg.RevDependsList()))
@@ -502,7 +1940,7 @@ static PyObject *PackageGetVersionList(PyObject *Self,void*)
    for (pkgCache::VerIterator I = Pkg.VersionList(); I.end() == false; I++)
    {
       PyObject *Obj;
-      Obj = CppPyObject_NEW<pkgCache::VerIterator>(Owner,&PyVersion_Type,I);
+      Obj = GetVersionObject(Owner,I);
       PyList_Append(List,Obj);
       Py_DECREF(Obj);
    }
@@ -517,8 +1955,7 @@ static PyObject *PackageGetCurrentVer(PyObject *Self,void*)
       Py_INCREF(Py_None);
       return Py_None;
    }
-   return CppPyObject_NEW<pkgCache::VerIterator>(Owner,&PyVersion_Type,
-							 Pkg.CurrentVer());
+   return GetVersionObject(Owner,Pkg.CurrentVer());
 }
 
 static PyGetSetDef PackageGetSet[] = {
@@ -548,6 +1985,18 @@ static PyObject *PackageRepr(PyObject *Self)
                               Pkg->ID);
 }
 
+static int PackageClear(PyObject *Self)
+{
+   ForgetUniqueObject<pkgCache::PkgIterator>(Self,&PkgCacheTables::PackageObjects);
+   return CppClear<pkgCache::PkgIterator>(Self);
+}
+
+static void PackageDealloc(PyObject *Self)
+{
+   ForgetUniqueObject<pkgCache::PkgIterator>(Self,&PkgCacheTables::PackageObjects);
+   CppDealloc<pkgCache::PkgIterator>(Self);
+}
+
 PyTypeObject PyPackage_Type =
 {
    PyVarObject_HEAD_INIT(&PyType_Type, 0)
@@ -555,7 +2004,7 @@ PyTypeObject PyPackage_Type =
    sizeof(CppPyObject<pkgCache::PkgIterator>),   // tp_basicsize
    0,                                   // tp_itemsize
    // Methods
-   CppDealloc<pkgCache::PkgIterator>,  // tp_dealloc
+   PackageDealloc,                      // tp_dealloc
    0,                                   // tp_print
    0,                                   // tp_getattr
    0,                                   // tp_setattr
@@ -573,7 +2022,7 @@ PyTypeObject PyPackage_Type =
    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, // tp_flags
    "Package Object",                    // tp_doc
    CppTraverse<pkgCache::PkgIterator>, // tp_traverse
-   CppClear<pkgCache::PkgIterator>,// tp_clear
+   PackageClear,                        // tp_clear
    0,                                   // tp_richcompare
    0,                                   // tp_weaklistoffset
    0,                                   // tp_iter
@@ -731,13 +2180,258 @@ static PyObject *MakeDepends(PyObject *Owner,pkgCache::VerIterator &Ver,
    return Dict;
 }
 
+/* Return the or-group Start..End as a list of Dependency objects. */
+static PyObject *MakeOrGroup(PyObject *Owner,pkgCache::DepIterator Start,
+			     pkgCache::DepIterator const &End)
+{
+   PyObject *OrGroup = PyList_New(0);
+   while (1)
+   {
+      PyObject *Obj = CppPyObject_NEW<pkgCache::DepIterator>(Owner,
+							     &PyDependency_Type,
+							     Start);
+      PyList_Append(OrGroup,Obj);
+      Py_DECREF(Obj);
+      if (Start == End)
+	 break;
+      Start++;
+   }
+   return OrGroup;
+}
+
+// DependsIterator - Iterate over the or-groups of a version		/*{{{*/
+// ---------------------------------------------------------------------
+struct DependsIterStruct
+{
+   pkgCache::DepIterator Iter;
+   // The dependency types to return, as a bit mask.
+   unsigned long Mask;
+
+   DependsIterStruct(pkgCache::DepIterator const &I) : Iter(I), Mask(~0UL) {};
+   DependsIterStruct() {abort();};  // G++ Bug..
+};
+
+static PyObject *DependsIterNext(PyObject *Self)
+{
+   DependsIterStruct &It = GetCpp<DependsIterStruct>(Self);
+   while (It.Iter.end() == false)
+   {
+      pkgCache::DepIterator Start;
+      pkgCache::DepIterator End;
+      It.Iter.GlobOr(Start,End);
+      if ((It.Mask & (1UL << Start->Type)) != 0)
+	 return MakeOrGroup(GetOwner<DependsIterStruct>(Self),Start,End);
+   }
+   return 0;
+}
+
+PyTypeObject PyDependsIterator_Type =
+{
+   PyVarObject_HEAD_INIT(&PyType_Type, 0)
+   "apt_pkg.DependsIterator",           // tp_name
+   sizeof(CppPyObject<DependsIterStruct>), // tp_basicsize
+   0,                                   // tp_itemsize
+   // Methods
+   CppDealloc<DependsIterStruct>,       // tp_dealloc
+   0,                                   // tp_print
+   0,                                   // tp_getattr
+   0,                                   // tp_setattr
+   0,                                   // tp_compare
+   0,                                   // tp_repr
+   0,                                   // tp_as_number
+   0,                                   // tp_as_sequence
+   0,                                   // tp_as_mapping
+   0,                                   // tp_hash
+   0,                                   // tp_call
+   0,                                   // tp_str
+   0,                                   // tp_getattro
+   0,                                   // tp_setattro
+   0,                                   // tp_as_buffer
+   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, // tp_flags
+   "Iterator over the or-groups of the dependencies of a version.", // tp_doc
+   CppTraverse<DependsIterStruct>,      // tp_traverse
+   CppClear<DependsIterStruct>,         // tp_clear
+   0,                                   // tp_richcompare
+   0,                                   // tp_weaklistoffset
+   PyObject_SelfIter,                   // tp_iter
+   DependsIterNext,                     // tp_iternext
+};
+									/*}}}*/
+// DependsView - Lazy mapping of dependency types to or-groups		/*{{{*/
+// ---------------------------------------------------------------------
+/* The view is a plain VerIterator; the or-groups of a type are only created
+   when that type is requested. */
+static unsigned long DependsTypes(pkgCache::VerIterator Ver)
+{
+   unsigned long Mask = 0;
+   for (pkgCache::DepIterator D = Ver.DependsList(); D.end() == false; D++)
+      Mask |= 1UL << D->Type;
+   return Mask;
+}
+
+static PyObject *DependsViewKeys(PyObject *Self,PyObject *Args)
+{
+   const int TypeCount = sizeof(UntranslatedDepTypes) / sizeof(*UntranslatedDepTypes);
+   unsigned long Mask = DependsTypes(GetCpp<pkgCache::VerIterator>(Self));
+   PyObject *List = PyList_New(0);
+   for (int I = 1; I != TypeCount; I++)
+   {
+      if ((Mask & (1UL << I)) == 0)
+	 continue;
+      PyObject *Name = PyString_FromString(UntranslatedDepTypes[I]);
+      PyList_Append(List,Name);
+      Py_DECREF(Name);
+   }
+   return List;
+}
+
+/* Return the or-groups of the given type, or NULL if there are none. Does
+   not set an exception in the latter case. */
+static PyObject *DependsViewLookup(PyObject *Self,long Type)
+{
+   pkgCache::VerIterator &Ver = GetCpp<pkgCache::VerIterator>(Self);
+   if ((DependsTypes(Ver) & (1UL << Type)) == 0)
+      return 0;
+
+   PyObject *Owner = GetOwner<pkgCache::VerIterator>(Self);
+   PyObject *List = PyList_New(0);
+   for (pkgCache::DepIterator D = Ver.DependsList(); D.end() == false;)
+   {
+      pkgCache::DepIterator Start;
+      pkgCache::DepIterator End;
+      D.GlobOr(Start,End);
+      if (Start->Type != Type)
+	 continue;
+      PyObject *OrGroup = MakeOrGroup(Owner,Start,End);
+      PyList_Append(List,OrGroup);
+      Py_DECREF(OrGroup);
+   }
+   return List;
+}
+
+static PyObject *DependsViewSubscript(PyObject *Self,PyObject *Key)
+{
+   long Type = ParseDepType(Key);
+   if (Type == -1)
+   {
+      // Behave like a dict for unknown keys.
+      if (PyErr_ExceptionMatches(PyExc_ValueError))
+	 PyErr_SetObject(PyExc_KeyError,Key);
+      return 0;
+   }
+   PyObject *List = DependsViewLookup(Self,Type);
+   if (List == 0)
+      PyErr_SetObject(PyExc_KeyError,Key);
+   return List;
+}
+
+static PyObject *DependsViewGet(PyObject *Self,PyObject *Args)
+{
+   PyObject *Key;
+   PyObject *Default = Py_None;
+   if (PyArg_ParseTuple(Args,"O|O",&Key,&Default) == 0)
+      return 0;
+   long Type = ParseDepType(Key);
+   PyObject *List = 0;
+   if (Type != -1)
+      List = DependsViewLookup(Self,Type);
+   PyErr_Clear();
+   if (List == 0)
+   {
+      Py_INCREF(Default);
+      return Default;
+   }
+   return List;
+}
+
+static Py_ssize_t DependsViewLen(PyObject *Self)
+{
+   unsigned long Mask = DependsTypes(GetCpp<pkgCache::VerIterator>(Self));
+   Py_ssize_t Len = 0;
+   for (; Mask != 0; Mask &= Mask - 1)
+      Len++;
+   return Len;
+}
+
+static int DependsViewContains(PyObject *Self,PyObject *Key)
+{
+   long Type = ParseDepType(Key);
+   if (Type == -1)
+   {
+      PyErr_Clear();
+      return 0;
+   }
+   return (DependsTypes(GetCpp<pkgCache::VerIterator>(Self)) & (1UL << Type)) != 0;
+}
+
+static PyObject *DependsViewIter(PyObject *Self)
+{
+   PyObject *Keys = DependsViewKeys(Self,0);
+   PyObject *Iter = PyObject_GetIter(Keys);
+   Py_DECREF(Keys);
+   return Iter;
+}
+
+static PyMethodDef DependsViewMethods[] =
+{
+   {"get",DependsViewGet,METH_VARARGS,
+    "get(type[, default]) -> list\n\n"
+    "Return the or-groups of the given type, or 'default'."},
+   {"keys",DependsViewKeys,METH_NOARGS,
+    "keys() -> list\n\nReturn the dependency types of the version."},
+   {}
+};
+
+static PySequenceMethods DependsViewSeq = {0,0,0,0,0,0,0,DependsViewContains,0,0};
+static PyMappingMethods DependsViewMap = {DependsViewLen,DependsViewSubscript,0};
+
+static char *doc_DependsView = "A read-only mapping of dependency types to\n"
+   "lists of or-groups, like Version.depends_list. The or-groups of a type\n"
+   "are only created when the type is looked up.";
+PyTypeObject PyDependsView_Type =
+{
+   PyVarObject_HEAD_INIT(&PyType_Type, 0)
+   "apt_pkg.DependsView",               // tp_name
+   sizeof(CppPyObject<pkgCache::VerIterator>), // tp_basicsize
+   0,                                   // tp_itemsize
+   // Methods
+   CppDealloc<pkgCache::VerIterator>,   // tp_dealloc
+   0,                                   // tp_print
+   0,                                   // tp_getattr
+   0,                                   // tp_setattr
+   0,                                   // tp_compare
+   0,                                   // tp_repr
+   0,                                   // tp_as_number
+   &DependsViewSeq,                     // tp_as_sequence
+   &DependsViewMap,                     // tp_as_mapping
+   0,                                   // tp_hash
+   0,                                   // tp_call
+   0,                                   // tp_str
+   0,                                   // tp_getattro
+   0,                                   // tp_setattro
+   0,                                   // tp_as_buffer
+   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, // tp_flags
+   doc_DependsView,                     // tp_doc
+   CppTraverse<pkgCache::VerIterator>,  // tp_traverse
+   CppClear<pkgCache::VerIterator>,     // tp_clear
+   0,                                   // tp_richcompare
+   0,                                   // tp_weaklistoffset
+   DependsViewIter,                     // tp_iter
+   0,                                   // tp_iternext
+   DependsViewMethods,                  // tp_methods
+};
+									/*}}}*/
+
 static inline pkgCache::VerIterator Version_GetVer(PyObject *Self) {
    return GetCpp<pkgCache::VerIterator>(Self);
 }
 
 // Version attributes.
 static PyObject *VersionGetVerStr(PyObject *Self, void*) {
-   return PyString_FromString(Version_GetVer(Self).VerStr());
+   PkgCacheTables *Tables = FindCacheTables(GetOwner<pkgCache::VerIterator>(Self));
+   if (Tables == 0)
+      return PyString_FromString(Version_GetVer(Self).VerStr());
+   return Tables->VersionString(Version_GetVer(Self));
 }
 static PyObject *VersionGetSection(PyObject *Self, void*) {
    return Safe_FromString(Version_GetVer(Self).Section());
@@ -771,10 +2465,14 @@ static PyObject *VersionGetDependsList(PyObject *Self, void*) {
    PyObject *Owner = GetOwner<pkgCache::VerIterator>(Self);
    return MakeDepends(Owner,Ver,true);
 }
+static PyObject *VersionGetDependsView(PyObject *Self, void*) {
+   PyObject *Owner = GetOwner<pkgCache::VerIterator>(Self);
+   return CppPyObject_NEW<pkgCache::VerIterator>(Owner,&PyDependsView_Type,
+						 Version_GetVer(Self));
+}
 static PyObject *VersionGetParentPkg(PyObject *Self, void*) {
    PyObject *Owner = GetOwner<pkgCache::VerIterator>(Self);
-   return CppPyObject_NEW<pkgCache::PkgIterator>(Owner,&PyPackage_Type,
-                                                      Version_GetVer(Self).ParentPkg());
+   return GetPackageObject(Owner,Version_GetVer(Self).ParentPkg());
 }
 static PyObject *VersionGetProvidesList(PyObject *Self, void*) {
    PyObject *Owner = GetOwner<pkgCache::VerIterator>(Self);
@@ -828,6 +2526,32 @@ static PyObject *VersionGetIsTrusted(PyObject *Self, void*) {
 
 #define NOTNULL(x) (x ? x : "")
 
+static PyObject *VersionIterDepends(PyObject *Self,PyObject *Args)
+{
+   unsigned long Mask;
+   if (ParseDepTypes(Args,Mask,~0UL) == false)
+      return 0;
+   if (PyTuple_GET_SIZE(Args) == 0)
+      Mask = ~0UL;
+
+   PyObject *Owner = GetOwner<pkgCache::VerIterator>(Self);
+   CppPyObject<DependsIterStruct> *Iter =
+      CppPyObject_NEW<DependsIterStruct>(Owner,&PyDependsIterator_Type,
+					 Version_GetVer(Self).DependsList());
+   Iter->Object.Mask = Mask;
+   return Iter;
+}
+
+static PyMethodDef VersionMethods[] =
+{
+   {"iter_depends",VersionIterDepends,METH_VARARGS,
+    "iter_depends(*types) -> iterator\n\n"
+    "Iterate over the or-groups (lists of Dependency objects) of the\n"
+    "dependencies of the given types (names like 'Depends' or numbers),\n"
+    "or of all dependencies if no type is given."},
+   {}
+};
+
 static PyObject *VersionRepr(PyObject *Self)
 {
    pkgCache::VerIterator &Ver = GetCpp<pkgCache::VerIterator>(Self);
@@ -846,6 +2570,7 @@ static PyGetSetDef VersionGetSet[] = {
    {"arch",VersionGetArch},
    {"depends_list",VersionGetDependsList},
    {"depends_list_str",VersionGetDependsListStr},
+   {"depends_view",VersionGetDependsView},
    {"downloadable",VersionGetDownloadable},
    {"file_list",VersionGetFileList},
    {"hash",VersionGetHash},
@@ -862,6 +2587,18 @@ static PyGetSetDef VersionGetSet[] = {
    {}
 };
 
+static int VersionClear(PyObject *Self)
+{
+   ForgetUniqueObject<pkgCache::VerIterator>(Self,&PkgCacheTables::VersionObjects);
+   return CppClear<pkgCache::VerIterator>(Self);
+}
+
+static void VersionDealloc(PyObject *Self)
+{
+   ForgetUniqueObject<pkgCache::VerIterator>(Self,&PkgCacheTables::VersionObjects);
+   CppDealloc<pkgCache::VerIterator>(Self);
+}
+
 PyTypeObject PyVersion_Type =
 {
    PyVarObject_HEAD_INIT(&PyType_Type, 0)
@@ -869,7 +2606,7 @@ PyTypeObject PyVersion_Type =
    sizeof(CppPyObject<pkgCache::VerIterator>),   // tp_basicsize
    0,                                   // tp_itemsize
    // Methods
-   CppDealloc<pkgCache::VerIterator>,          // tp_dealloc
+   VersionDealloc,                      // tp_dealloc
    0,                                   // tp_print
    0,                                   // tp_getattr
    0,                                   // tp_setattr
@@ -887,12 +2624,12 @@ PyTypeObject PyVersion_Type =
    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,                  // tp_flags
    "Version Object",                    // tp_doc
    CppTraverse<pkgCache::VerIterator>, // tp_traverse
-   CppClear<pkgCache::VerIterator>,// tp_clear
+   VersionClear,                        // tp_clear
    0,                                   // tp_richcompare
    0,                                   // tp_weaklistoffset
    0,                                   // tp_iter
    0,                                   // tp_iternext
-   0,                                   // tp_methods
+   VersionMethods,                      // tp_methods
    0,                                   // tp_members
    VersionGetSet,                       // tp_getset
 };
@@ -1070,7 +2807,7 @@ static PyObject *DepSmartTargetPkg(PyObject *Self,PyObject *Args)
       return Py_None;
    }
 
-   return CppPyObject_NEW<pkgCache::PkgIterator>(Owner,&PyPackage_Type,P);
+   return GetPackageObject(Owner,P);
 }
 
 static PyObject *DepAllTargets(PyObject *Self,PyObject *Args)
@@ -1086,8 +2823,7 @@ static PyObject *DepAllTargets(PyObject *Self,PyObject *Args)
    for (pkgCache::Version **I = Vers; *I != 0; I++)
    {
       PyObject *Obj;
-      Obj = CppPyObject_NEW<pkgCache::VerIterator>(Owner,&PyVersion_Type,
-							pkgCache::VerIterator(*Dep.Cache(),*I));
+      Obj = GetVersionObject(Owner,pkgCache::VerIterator(*Dep.Cache(),*I));
       PyList_Append(List,Obj);
       Py_DECREF(Obj);
    }
@@ -1116,24 +2852,21 @@ static PyObject *DependencyGetTargetPkg(PyObject *Self,void*)
 {
    pkgCache::DepIterator &Dep = GetCpp<pkgCache::DepIterator>(Self);
    PyObject *Owner = GetOwner<pkgCache::DepIterator>(Self);
-   return CppPyObject_NEW<pkgCache::PkgIterator>(Owner,&PyPackage_Type,
-                                                      Dep.TargetPkg());
+   return GetPackageObject(Owner,Dep.TargetPkg());
 }
 
 static PyObject *DependencyGetParentVer(PyObject *Self,void*)
 {
    pkgCache::DepIterator &Dep = GetCpp<pkgCache::DepIterator>(Self);
    PyObject *Owner = GetOwner<pkgCache::DepIterator>(Self);
-   return CppPyObject_NEW<pkgCache::VerIterator>(Owner,&PyVersion_Type,
-                                                      Dep.ParentVer());
+   return GetVersionObject(Owner,Dep.ParentVer());
 }
 
 static PyObject *DependencyGetParentPkg(PyObject *Self,void*)
 {
    pkgCache::DepIterator &Dep = GetCpp<pkgCache::DepIterator>(Self);
    PyObject *Owner = GetOwner<pkgCache::DepIterator>(Self);
-   return CppPyObject_NEW<pkgCache::PkgIterator>(Owner,&PyPackage_Type,
-                                                      Dep.ParentPkg());
+   return GetPackageObject(Owner,Dep.ParentPkg());
 }
 
 static PyObject *DependencyGetCompType(PyObject *Self,void*)
@@ -0,0 +1,104 @@
+// -*- mode: cpp; mode: fold -*-
+// Description								/*{{{*/
+/* ######################################################################
+
+   cache.h - Shared structures of the Cache wrapper
+
+   The apt_pkg.Cache object carries a set of lookup tables which are built
+   lazily on first use and are shared by all objects created from the
+   cache (package lists, depcaches, ...). They are only valid as long as
+   the underlying pkgCache is not replaced.
+
+   ##################################################################### */
+									/*}}}*/
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "generic.h"
+#include <apt-pkg/pkgcache.h>
+#include <apt-pkg/cachefile.h>
+#include <apt-pkg/depcache.h>
+#include <vector>
+
+struct PkgCacheTables
+{
+   pkgCache *Cache;
+
+   // All packages, indexed by their ID.
+   std::vector<pkgCache::Package *> Packages;
+   // All versions, indexed by their ID.
+   std::vector<pkgCache::Version *> Versions;
+
+   // Interned package names and version strings, indexed by ID.
+   std::vector<PyObject *> Names;
+   std::vector<PyObject *> VerStrs;
+
+   // Borrowed references to the unique Package and Version objects of
+   // caches created with unique_objects=True, indexed by ID. The objects
+   // remove themselves from here when they are deallocated.
+   std::vector<PyObject *> PackageObjects;
+   std::vector<PyObject *> VersionObjects;
+
+   // Open addressing hash table of package IDs keyed by package name, with
+   // a power of two size and 0xFFFFFFFF marking free slots. Only built on
+   // request by BuildNameIndex().
+   std::vector<unsigned int> NameIndex;
+
+   PkgCacheTables(pkgCache *Cache) : Cache(Cache) {};
+   ~PkgCacheTables();
+
+   pkgCache::Package **PackageTable();
+   pkgCache::Version **VersionTable();
+
+   void BuildNameIndex();
+   // Find a package by name, using the name index if it has been built.
+   pkgCache::Package *FindPackage(const char *Name);
+
+   // Return new references to the (cached) name and version string.
+   PyObject *PackageName(pkgCache::PkgIterator const &Pkg);
+   PyObject *VersionString(pkgCache::VerIterator const &Ver);
+};
+
+// Opens a pkgCacheFile by mapping the existing binary cache read-only and
+// shared, used by apt_pkg.Cache(readonly_mmap=True). Nothing is (re)built;
+// opening fails if the cache is out of date. The depcache is created on
+// first use. This class is never instantiated, it only gives access to the
+// protected members of pkgCacheFile.
+class ReadOnlyCacheFile : public pkgCacheFile
+{
+   public:
+   static bool Open(pkgCacheFile &File);
+   static pkgDepCache *GetDepCache(pkgCacheFile &File);
+};
+
+// The Python object behind apt_pkg.Cache.
+struct PkgCacheData : public CppPyObject<pkgCache*>
+{
+   PkgCacheTables *Tables;
+   // Whether each package and version is wrapped by only one object.
+   bool UniqueObjects;
+   // What had to be rebuilt when opening the cache, see rebuild_stats.
+   PyObject *RebuildStats;
+   // Whether the cache file has been opened by ReadOnlyCacheFile::Open().
+   bool ReadOnly;
+};
+
+// Return the tables of the apt_pkg.Cache object Self, creating them if needed.
+PkgCacheTables *GetCacheTables(PyObject *Self);
+// Like GetCacheTables(), but for the cache owning the cache object Obj
+// (a package, version, ...). Returns NULL if there is no such cache.
+PkgCacheTables *FindCacheTables(PyObject *Obj);
+
+// Return a Package or Version object for Pkg or Ver, owned by Owner. If
+// the cache has been created with unique_objects=True, the existing object
+// for the ID is returned instead of a new one.
+PyObject *GetPackageObject(PyObject *Owner,pkgCache::PkgIterator const &Pkg);
+PyObject *GetVersionObject(PyObject *Owner,pkgCache::VerIterator const &Ver);
+
+// Append the packages in the iterable Seq, given as Package objects or as
+// package IDs of the apt_pkg.Cache object Self, to Pkgs. Returns false
+// with an exception set on error.
+bool ParsePackageRefs(PyObject *Self,PyObject *Seq,
+		      std::vector<pkgCache::Package *> &Pkgs);
+
+#endif
@@ -0,0 +1,231 @@
+// -*- mode: cpp; mode: fold -*-
+// Description								/*{{{*/
+/* ######################################################################
+
+   Columns - Read-only typed arrays for bulk data exports
+
+   A Column is a contiguous array of fixed-size unsigned integers (or
+   signed 64 bit integers). It is used for returning bulk data like
+   package IDs or sizes from the cache without creating one Python object
+   per item. Columns implement the sequence protocol and, if available,
+   the new buffer protocol, so they can be passed to memoryview() or
+   numpy.asarray() without copying.
+
+   ##################################################################### */
+									/*}}}*/
+// Include Files							/*{{{*/
+#include "generic.h"
+#include "apt_pkgmodule.h"
+
+#include <cstring>
+#include <Python.h>
+									/*}}}*/
+
+struct ColumnStruct
+{
+   // The struct module format character, followed by a NUL.
+   char Format[2];
+   Py_ssize_t ItemSize;
+   Py_ssize_t Length;
+   char *Data;
+
+   ColumnStruct() : ItemSize(0), Length(0), Data(0) {Format[0] = Format[1] = 0;}
+   ~ColumnStruct() {free(Data);}
+};
+
+static Py_ssize_t ColumnItemSize(char Format)
+{
+   switch (Format)
+   {
+      case 'B': return sizeof(unsigned char);
+      case 'H': return sizeof(unsigned short);
+      case 'I': return sizeof(unsigned int);
+      case 'Q': return sizeof(unsigned long long);
+      case 'q': return sizeof(long long);
+   }
+   return 0;
+}
+
+// PyColumn_New - Create a new, zero-filled column			/*{{{*/
+// ---------------------------------------------------------------------
+PyObject *PyColumn_New(char Format,Py_ssize_t Length)
+{
+   Py_ssize_t ItemSize = ColumnItemSize(Format);
+   if (ItemSize == 0)
+   {
+      PyErr_Format(PyExc_ValueError,"Unsupported column format '%c'",Format);
+      return 0;
+   }
+
+   CppPyObject<ColumnStruct> *Col = CppPyObject_NEW<ColumnStruct>(0,&PyColumn_Type);
+   ColumnStruct &Column = Col->Object;
+   Column.Format[0] = Format;
+   Column.ItemSize = ItemSize;
+   Column.Length = Length;
+   // Always allocate at least one item, so Data is never NULL.
+   Column.Data = (char *)calloc(Length > 0 ? Length : 1,ItemSize);
+   if (Column.Data == 0)
+   {
+      Py_DECREF(Col);
+      return PyErr_NoMemory();
+   }
+   return Col;
+}
+
+void *PyColumn_Data(PyObject *Self)
+{
+   return GetCpp<ColumnStruct>(Self).Data;
+}
+
+void PyColumn_SetItem(PyObject *Self,Py_ssize_t Index,unsigned long long Value)
+{
+   ColumnStruct &Column = GetCpp<ColumnStruct>(Self);
+   switch (Column.Format[0])
+   {
+      case 'B': ((unsigned char *)Column.Data)[Index] = Value; break;
+      case 'H': ((unsigned short *)Column.Data)[Index] = Value; break;
+      case 'I': ((unsigned int *)Column.Data)[Index] = Value; break;
+      case 'Q': ((unsigned long long *)Column.Data)[Index] = Value; break;
+      case 'q': ((long long *)Column.Data)[Index] = (long long)Value; break;
+   }
+}
+									/*}}}*/
+// Column Class								/*{{{*/
+// ---------------------------------------------------------------------
+static Py_ssize_t ColumnLen(PyObject *Self)
+{
+   return GetCpp<ColumnStruct>(Self).Length;
+}
+
+static PyObject *ColumnItem(PyObject *Self,Py_ssize_t Index)
+{
+   ColumnStruct &Column = GetCpp<ColumnStruct>(Self);
+   if (Index < 0 || Index >= Column.Length)
+   {
+      PyErr_SetNone(PyExc_IndexError);
+      return 0;
+   }
+
+   switch (Column.Format[0])
+   {
+      case 'B': return Py_BuildValue("i",((unsigned char *)Column.Data)[Index]);
+      case 'H': return Py_BuildValue("i",((unsigned short *)Column.Data)[Index]);
+      case 'I': return Py_BuildValue("k",(unsigned long)((unsigned int *)Column.Data)[Index]);
+      case 'Q': return Py_BuildValue("K",((unsigned long long *)Column.Data)[Index]);
+      case 'q': return Py_BuildValue("L",((long long *)Column.Data)[Index]);
+   }
+   PyErr_SetString(PyExc_SystemError,"Invalid column format");
+   return 0;
+}
+
+#ifdef HAVE_NEWBUFFER
+static int ColumnGetBuffer(PyObject *Self,Py_buffer *View,int Flags)
+{
+   ColumnStruct &Column = GetCpp<ColumnStruct>(Self);
+   if ((Flags & PyBUF_WRITABLE) == PyBUF_WRITABLE)
+   {
+      PyErr_SetString(PyExc_BufferError,"Column objects are read-only");
+      View->obj = 0;
+      return -1;
+   }
+
+   View->obj = Self;
+   Py_INCREF(Self);
+   View->buf = Column.Data;
+   View->len = Column.Length * Column.ItemSize;
+   View->readonly = 1;
+   View->itemsize = Column.ItemSize;
+   View->format = (Flags & PyBUF_FORMAT) == PyBUF_FORMAT ? Column.Format : 0;
+   View->ndim = 1;
+   View->shape = (Flags & PyBUF_ND) == PyBUF_ND ? &Column.Length : 0;
+   View->strides = (Flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &Column.ItemSize : 0;
+   View->suboffsets = 0;
+   View->internal = 0;
+   return 0;
+}
+
+#if PY_MAJOR_VERSION >= 3
+static PyBufferProcs ColumnBuffer = {ColumnGetBuffer,0};
+#else
+static PyBufferProcs ColumnBuffer = {0,0,0,0,ColumnGetBuffer,0};
+#endif
+#define COLUMN_BUFFER (&ColumnBuffer)
+#else
+#define COLUMN_BUFFER 0
+#endif
+
+static PyObject *ColumnGetTypeCode(PyObject *Self,void*)
+{
+   return PyString_FromString(GetCpp<ColumnStruct>(Self).Format);
+}
+
+static PyObject *ColumnGetItemSize(PyObject *Self,void*)
+{
+   return Py_BuildValue("i",(int)GetCpp<ColumnStruct>(Self).ItemSize);
+}
+
+static PyObject *ColumnRepr(PyObject *Self)
+{
+   ColumnStruct &Column = GetCpp<ColumnStruct>(Self);
+   return PyString_FromFormat("<%s object: typecode:'%s' length:%ld>",
+                              Self->ob_type->tp_name,Column.Format,
+                              (long)Column.Length);
+}
+
+static PyGetSetDef ColumnGetSet[] = {
+   {"itemsize",ColumnGetItemSize,0,"The size of one item, in bytes."},
+   {"typecode",ColumnGetTypeCode,0,"The struct module format character of the items."},
+   {}
+};
+
+static PySequenceMethods ColumnSeq =
+{
+   ColumnLen,
+   0,                // concat
+   0,                // repeat
+   ColumnItem,
+   0,                // slice
+   0,                // assign item
+   0                 // assign slice
+};
+
+static char *doc_Column = "A read-only array of integers.\n\n"
+    "Column objects are returned by bulk queries like Cache.export_columns().\n"
+    "They support len() and indexing and export their data through the\n"
+    "buffer protocol, e.g. for memoryview() or numpy.asarray().";
+PyTypeObject PyColumn_Type =
+{
+   PyVarObject_HEAD_INIT(&PyType_Type, 0)
+   "apt_pkg.Column",                    // tp_name
+   sizeof(CppPyObject<ColumnStruct>),   // tp_basicsize
+   0,                                   // tp_itemsize
+   // Methods
+   CppDealloc<ColumnStruct>,            // tp_dealloc
+   0,                                   // tp_print
+   0,                                   // tp_getattr
+   0,                                   // tp_setattr
+   0,                                   // tp_compare
+   ColumnRepr,                          // tp_repr
+   0,                                   // tp_as_number
+   &ColumnSeq,                          // tp_as_sequence
+   0,                                   // tp_as_mapping
+   0,                                   // tp_hash
+   0,                                   // tp_call
+   0,                                   // tp_str
+   0,                                   // tp_getattro
+   0,                                   // tp_setattro
+   COLUMN_BUFFER,                       // tp_as_buffer
+   (Py_TPFLAGS_DEFAULT |                // tp_flags
+    Py_TPFLAGS_HAVE_NEWBUFFER),
+   doc_Column,                          // tp_doc
+   0,                                   // tp_traverse
+   0,                                   // tp_clear
+   0,                                   // tp_richcompare
+   0,                                   // tp_weaklistoffset
+   0,                                   // tp_iter
+   0,                                   // tp_iternext
+   0,                                   // tp_methods
+   0,                                   // tp_members
+   ColumnGetSet,                        // tp_getset
+};
+									/*}}}*/
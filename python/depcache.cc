@@ -10,6 +10,7 @@
 // Include Files							/*{{{*/
 #include "generic.h"
 #include "apt_pkgmodule.h"
+#include "cache.h"
 
 #include <apt-pkg/pkgcache.h>
 #include <apt-pkg/cachefile.h>
@@ -25,6 +26,11 @@
 #include <Python.h>
 
 #include <iostream>
+#include <cstring>
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
 #include "progress.h"
 
 #ifndef _
@@ -33,6 +39,519 @@
 
 
 
+// DepCacheState - Access to the marking state of a pkgDepCache	/*{{{*/
+// ---------------------------------------------------------------------
+/* pkgDepCache keeps the per package and per dependency state and the
+   counters derived from them in protected members. This class is never
+   instantiated; it only takes pointers to these members, which we may do
+   as a subclass. */
+class DepCacheState : public pkgDepCache
+{
+   public:
+
+   // The start of a saved state, followed by PkgState and DepState.
+   struct Header
+   {
+      pkgCache *Cache;
+      unsigned long PackageCount;
+      unsigned long DependsCount;
+      double UsrSize;
+      double DownloadSize;
+      unsigned long InstCount;
+      unsigned long DelCount;
+      unsigned long KeepCount;
+      unsigned long BrokenCount;
+      unsigned long PolicyBrokenCount;
+      unsigned long BadCount;
+   };
+
+   static StateCache *PackageStates(pkgDepCache &Cache)
+   {
+      return Cache.*(&DepCacheState::PkgState);
+   }
+   static unsigned char *DependencyStates(pkgDepCache &Cache)
+   {
+      return Cache.*(&DepCacheState::DepState);
+   }
+
+   // The changes made by one marking operation, see DepCache.undo().
+   struct Delta
+   {
+      Header Before;
+      Header After;
+      std::vector<unsigned long> Packages;
+      std::vector<StateCache> OldPackages;
+      std::vector<StateCache> NewPackages;
+      std::vector<unsigned long> Depends;
+      std::vector<unsigned char> OldDepends;
+      std::vector<unsigned char> NewDepends;
+   };
+
+   static void GetHeader(pkgDepCache &Cache,Header &Head);
+   static void SetCounters(pkgDepCache &Cache,Header const &Head);
+
+   static std::string Save(pkgDepCache &Cache);
+   static bool Restore(pkgDepCache &Cache,std::string const &Data);
+   // Give To, which has not been initialized, the state of From.
+   static void Copy(pkgDepCache &To,pkgDepCache &From);
+   // Store the differences between the state in Data and the current one.
+   static void Diff(pkgDepCache &Cache,std::string const &Data,Delta &Change);
+   // Revert Change. Fails if the current state is not the one it produced.
+   static bool Undo(pkgDepCache &Cache,Delta const &Change);
+   // The number of packages whose state differs from the one in Data.
+   static unsigned long CountChanged(pkgDepCache &Cache,std::string const &Data);
+   // Append the IDs of the packages whose mode or install version differs
+   // from the one in Data to IDs.
+   static void ChangedIds(pkgDepCache &Cache,std::string const &Data,
+			  std::vector<unsigned int> &IDs);
+};
+
+void DepCacheState::GetHeader(pkgDepCache &Cache,Header &Head)
+{
+   memset(&Head,0,sizeof(Head));
+   Head.Cache = &Cache.GetCache();
+   Head.PackageCount = Head.Cache->HeaderP->PackageCount;
+   Head.DependsCount = Head.Cache->HeaderP->DependsCount;
+   Head.UsrSize = Cache.*(&DepCacheState::iUsrSize);
+   Head.DownloadSize = Cache.*(&DepCacheState::iDownloadSize);
+   Head.InstCount = Cache.*(&DepCacheState::iInstCount);
+   Head.DelCount = Cache.*(&DepCacheState::iDelCount);
+   Head.KeepCount = Cache.*(&DepCacheState::iKeepCount);
+   Head.BrokenCount = Cache.*(&DepCacheState::iBrokenCount);
+   Head.PolicyBrokenCount = Cache.*(&DepCacheState::iPolicyBrokenCount);
+   Head.BadCount = Cache.*(&DepCacheState::iBadCount);
+}
+
+void DepCacheState::SetCounters(pkgDepCache &Cache,Header const &Head)
+{
+   Cache.*(&DepCacheState::iUsrSize) = Head.UsrSize;
+   Cache.*(&DepCacheState::iDownloadSize) = Head.DownloadSize;
+   Cache.*(&DepCacheState::iInstCount) = Head.InstCount;
+   Cache.*(&DepCacheState::iDelCount) = Head.DelCount;
+   Cache.*(&DepCacheState::iKeepCount) = Head.KeepCount;
+   Cache.*(&DepCacheState::iBrokenCount) = Head.BrokenCount;
+   Cache.*(&DepCacheState::iPolicyBrokenCount) = Head.PolicyBrokenCount;
+   Cache.*(&DepCacheState::iBadCount) = Head.BadCount;
+}
+
+std::string DepCacheState::Save(pkgDepCache &Cache)
+{
+   Header Head;
+   GetHeader(Cache,Head);
+
+   std::string Data((const char *)&Head,sizeof(Head));
+   Data.append((const char *)PackageStates(Cache),
+	       Head.PackageCount * sizeof(StateCache));
+   Data.append((const char *)DependencyStates(Cache),Head.DependsCount);
+   return Data;
+}
+
+bool DepCacheState::Restore(pkgDepCache &Cache,std::string const &Data)
+{
+   if (Data.size() < sizeof(Header))
+      return false;
+   Header Head;
+   memcpy(&Head,Data.data(),sizeof(Head));
+   if (Head.Cache != &Cache.GetCache() ||
+       Head.PackageCount != Head.Cache->HeaderP->PackageCount ||
+       Head.DependsCount != Head.Cache->HeaderP->DependsCount ||
+       Data.size() != sizeof(Head) + Head.PackageCount * sizeof(StateCache) +
+		      Head.DependsCount)
+      return false;
+
+   const char *Pos = Data.data() + sizeof(Head);
+   memcpy(PackageStates(Cache),Pos,Head.PackageCount * sizeof(StateCache));
+   Pos += Head.PackageCount * sizeof(StateCache);
+   memcpy(DependencyStates(Cache),Pos,Head.DependsCount);
+   SetCounters(Cache,Head);
+   return true;
+}
+
+void DepCacheState::Copy(pkgDepCache &To,pkgDepCache &From)
+{
+   Header Head;
+   GetHeader(From,Head);
+   // Allocated like pkgDepCache::Init() does, the destructor frees them.
+   StateCache *&PkgState = To.*(&DepCacheState::PkgState);
+   unsigned char *&DepState = To.*(&DepCacheState::DepState);
+   delete [] PkgState;
+   delete [] DepState;
+   PkgState = new StateCache[Head.PackageCount];
+   DepState = new unsigned char[Head.DependsCount];
+   memcpy(PkgState,PackageStates(From),Head.PackageCount * sizeof(StateCache));
+   memcpy(DepState,DependencyStates(From),Head.DependsCount);
+   SetCounters(To,Head);
+}
+
+void DepCacheState::Diff(pkgDepCache &Cache,std::string const &Data,
+			 Delta &Change)
+{
+   GetHeader(Cache,Change.After);
+   unsigned long PackageCount = Change.After.PackageCount;
+   unsigned long DependsCount = Change.After.DependsCount;
+   if (Data.size() != sizeof(Header) + PackageCount * sizeof(StateCache) +
+		      DependsCount)
+      return;
+   memcpy(&Change.Before,Data.data(),sizeof(Header));
+
+   const char *Old = Data.data() + sizeof(Header);
+   StateCache *New = PackageStates(Cache);
+   StateCache State;
+   for (unsigned long I = 0; I < PackageCount; I++, Old += sizeof(StateCache))
+   {
+      if (memcmp(Old,&New[I],sizeof(StateCache)) == 0)
+	 continue;
+      memcpy(&State,Old,sizeof(State));
+      Change.Packages.push_back(I);
+      Change.OldPackages.push_back(State);
+      Change.NewPackages.push_back(New[I]);
+   }
+
+   unsigned char *NewDep = DependencyStates(Cache);
+   for (unsigned long I = 0; I < DependsCount; I++, Old++)
+   {
+      if ((unsigned char)*Old == NewDep[I])
+	 continue;
+      Change.Depends.push_back(I);
+      Change.OldDepends.push_back(*Old);
+      Change.NewDepends.push_back(NewDep[I]);
+   }
+}
+
+bool DepCacheState::Undo(pkgDepCache &Cache,Delta const &Change)
+{
+   /* All counters have to match, as they are overwritten with the ones
+      from before the change. */
+   Header Head;
+   GetHeader(Cache,Head);
+   if (Head.Cache != Change.After.Cache ||
+       Head.UsrSize != Change.After.UsrSize ||
+       Head.DownloadSize != Change.After.DownloadSize ||
+       Head.InstCount != Change.After.InstCount ||
+       Head.DelCount != Change.After.DelCount ||
+       Head.KeepCount != Change.After.KeepCount ||
+       Head.BrokenCount != Change.After.BrokenCount ||
+       Head.PolicyBrokenCount != Change.After.PolicyBrokenCount ||
+       Head.BadCount != Change.After.BadCount)
+      return false;
+
+   /* Only compare the marks; the garbage flags may have been updated
+      since, e.g. when an action group was released. */
+   StateCache *States = PackageStates(Cache);
+   for (size_t I = 0; I != Change.Packages.size(); I++)
+   {
+      StateCache const &Now = States[Change.Packages[I]];
+      StateCache const &Then = Change.NewPackages[I];
+      if (Now.Mode != Then.Mode || Now.InstallVer != Then.InstallVer ||
+	  Now.CandidateVer != Then.CandidateVer || Now.iFlags != Then.iFlags)
+	 return false;
+   }
+
+   for (size_t I = 0; I != Change.Packages.size(); I++)
+      States[Change.Packages[I]] = Change.OldPackages[I];
+   unsigned char *DepStates = DependencyStates(Cache);
+   for (size_t I = 0; I != Change.Depends.size(); I++)
+      DepStates[Change.Depends[I]] = Change.OldDepends[I];
+   SetCounters(Cache,Change.Before);
+   return true;
+}
+
+unsigned long DepCacheState::CountChanged(pkgDepCache &Cache,
+					  std::string const &Data)
+{
+   unsigned long Count = Cache.GetCache().HeaderP->PackageCount;
+   if (Data.size() < sizeof(Header) + Count * sizeof(StateCache))
+      return Count;
+
+   const char *Old = Data.data() + sizeof(Header);
+   const char *New = (const char *)PackageStates(Cache);
+   unsigned long Changed = 0;
+   for (unsigned long I = 0; I < Count; I++)
+   {
+      if (memcmp(Old,New,sizeof(StateCache)) != 0)
+	 Changed++;
+      Old += sizeof(StateCache);
+      New += sizeof(StateCache);
+   }
+   return Changed;
+}
+
+void DepCacheState::ChangedIds(pkgDepCache &Cache,std::string const &Data,
+			       std::vector<unsigned int> &IDs)
+{
+   unsigned long Count = Cache.GetCache().HeaderP->PackageCount;
+   if (Data.size() < sizeof(Header) + Count * sizeof(StateCache))
+      return;
+
+   const char *Old = Data.data() + sizeof(Header);
+   StateCache *New = PackageStates(Cache);
+   StateCache State;
+   for (unsigned long I = 0; I < Count; I++, Old += sizeof(StateCache))
+   {
+      memcpy(&State,Old,sizeof(State));
+      if (State.Mode != New[I].Mode || State.InstallVer != New[I].InstallVer)
+	 IDs.push_back(I);
+   }
+}
+									/*}}}*/
+// DepCacheObject - The Python objects of DepCache and ProblemResolver	/*{{{*/
+// ---------------------------------------------------------------------
+/* All members are zero-initialized by tp_alloc(). */
+template <class T> struct DepCacheObject : public CppPyObject<T>
+{
+   // Statistics about the last solver run, see collect_stats.
+   bool CollectStats;
+   PyObject *Stats;
+   // The number of protect() and remove() calls since the last solver run
+   // (ProblemResolver only).
+   unsigned long ProtectCount;
+   unsigned long RemoveCount;
+   // The marking journal, if kept (DepCache only).
+   std::vector<DepCacheState::Delta> *Journal;
+};
+
+template <class T> static void DepCacheObjectDealloc(PyObject *Self)
+{
+   DepCacheObject<T> *Obj = (DepCacheObject<T> *)Self;
+   Py_CLEAR(Obj->Stats);
+   delete Obj->Journal;
+   CppDeallocPtr<T>(Self);
+}
+									/*}}}*/
+// Solver statistics							/*{{{*/
+// ---------------------------------------------------------------------
+/* DepCache and ProblemResolver objects record statistics about their last
+   solver run in their stats attribute if collect_stats is set. */
+
+/* Measures one solver run. The phase methods do not need the GIL, so they
+   can be called while it is released. Nothing is recorded if the object
+   has been created with Enabled = false. */
+class SolverRun
+{
+   pkgDepCache &Cache;
+   bool Enabled;
+   std::string Before;
+   unsigned long BrokenBefore;
+   struct timeval PhaseStart;
+   std::vector<std::pair<const char *,double> > Phases;
+
+   public:
+   SolverRun(pkgDepCache &Cache,bool Enabled) : Cache(Cache), Enabled(Enabled),
+      BrokenBefore(0)
+   {
+      if (Enabled == false)
+	 return;
+      Before = DepCacheState::Save(Cache);
+      BrokenBefore = Cache.BrokenCount();
+   }
+
+   void BeginPhase()
+   {
+      if (Enabled == true)
+	 gettimeofday(&PhaseStart,0);
+   }
+
+   void EndPhase(const char *Name)
+   {
+      if (Enabled == false)
+	 return;
+      struct timeval End;
+      gettimeofday(&End,0);
+      Phases.push_back(std::make_pair(Name,(End.tv_sec - PhaseStart.tv_sec) +
+				      (End.tv_usec - PhaseStart.tv_usec) / 1000000.0));
+   }
+
+   // Return a new dictionary describing the run, or NULL if disabled.
+   PyObject *Finish()
+   {
+      if (Enabled == false)
+	 return 0;
+      double Total = 0;
+      PyObject *PhaseTimes = PyDict_New();
+      for (std::vector<std::pair<const char *,double> >::iterator I = Phases.begin();
+	   I != Phases.end(); I++)
+      {
+	 PyObject *Time = PyFloat_FromDouble(I->second);
+	 PyDict_SetItemString(PhaseTimes,I->first,Time);
+	 Py_DECREF(Time);
+	 Total += I->second;
+      }
+      return Py_BuildValue("{s:d,s:N,s:k,s:k,s:k}","time",Total,
+			   "phases",PhaseTimes,
+			   "changed_packages",
+			   DepCacheState::CountChanged(Cache,Before),
+			   "broken_before",BrokenBefore,
+			   "broken_after",Cache.BrokenCount());
+   }
+};
+
+template <class T> static bool SolverStatsEnabled(PyObject *Self)
+{
+   return ((DepCacheObject<T> *)Self)->CollectStats;
+}
+
+/* Replace the stats of Self by the ones of Run, if enabled. The protect()
+   and remove() counters start again for the next run either way. */
+template <class T> static void SolverStatsStore(PyObject *Self,SolverRun &Run)
+{
+   DepCacheObject<T> *Obj = (DepCacheObject<T> *)Self;
+   unsigned long ProtectCount = Obj->ProtectCount;
+   unsigned long RemoveCount = Obj->RemoveCount;
+   Obj->ProtectCount = 0;
+   Obj->RemoveCount = 0;
+   if (Obj->CollectStats == false)
+      return;
+   PyObject *Stats = Run.Finish();
+   if (Stats != 0 && PyObject_TypeCheck(Self,&PyProblemResolver_Type))
+   {
+      PyObject *Value = Py_BuildValue("k",ProtectCount);
+      PyDict_SetItemString(Stats,"protect_count",Value);
+      Py_DECREF(Value);
+      Value = Py_BuildValue("k",RemoveCount);
+      PyDict_SetItemString(Stats,"remove_count",Value);
+      Py_DECREF(Value);
+   }
+   Py_XDECREF(Obj->Stats);
+   Obj->Stats = Stats;
+}
+
+template <class T> static PyObject *SolverGetCollectStats(PyObject *Self,void*)
+{
+   return PyBool_FromLong(((DepCacheObject<T> *)Self)->CollectStats);
+}
+
+template <class T> static int SolverSetCollectStats(PyObject *Self,
+						    PyObject *Value,void*)
+{
+   if (Value == 0)
+   {
+      PyErr_SetString(PyExc_TypeError,"Cannot delete the collect_stats attribute");
+      return -1;
+   }
+   int Res = PyObject_IsTrue(Value);
+   if (Res == -1)
+      return -1;
+   ((DepCacheObject<T> *)Self)->CollectStats = Res;
+   return 0;
+}
+
+template <class T> static PyObject *SolverGetStats(PyObject *Self,void*)
+{
+   PyObject *Stats = ((DepCacheObject<T> *)Self)->Stats;
+   if (Stats == 0)
+      Stats = Py_None;
+   Py_INCREF(Stats);
+   return Stats;
+}
+									/*}}}*/
+// Marking journal							/*{{{*/
+// ---------------------------------------------------------------------
+/* Records the changes made by one marking operation in the journal of a
+   DepCache object, if it keeps one. Every method changing the marks has
+   to use it, otherwise undo() refuses to apply the journal. Recording
+   saves and compares the state of all packages, so it costs time linear
+   in the size of the cache. Finish() does not need the GIL. */
+class JournalRecorder
+{
+   pkgDepCache &Cache;
+   std::vector<DepCacheState::Delta> *Journal;
+   std::string Before;
+
+   public:
+   JournalRecorder(PyObject *Self) : Cache(*GetCpp<pkgDepCache *>(Self)),
+      Journal(((DepCacheObject<pkgDepCache *> *)Self)->Journal)
+   {
+      if (Journal != 0)
+	 Before = DepCacheState::Save(Cache);
+   }
+
+   void Finish()
+   {
+      if (Journal == 0)
+	 return;
+      Journal->push_back(DepCacheState::Delta());
+      DepCacheState::Diff(Cache,Before,Journal->back());
+   }
+};
+
+static void ClearJournal(PyObject *Self)
+{
+   std::vector<DepCacheState::Delta> *Journal =
+      ((DepCacheObject<pkgDepCache *> *)Self)->Journal;
+   if (Journal != 0)
+      Journal->clear();
+}
+
+static PyObject *PkgDepCacheUndo(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   std::vector<DepCacheState::Delta> *Journal =
+      ((DepCacheObject<pkgDepCache *> *)Self)->Journal;
+   int Steps = 1;
+   if (PyArg_ParseTuple(Args,"|i",&Steps) == 0)
+      return 0;
+
+   if (Steps < 0)
+   {
+      PyErr_SetString(PyExc_ValueError,"Cannot undo a negative number of steps");
+      return 0;
+   }
+   if (Journal == 0 || (size_t)Steps > Journal->size())
+   {
+      PyErr_SetString(PyExc_IndexError,"Not enough steps in the journal");
+      return 0;
+   }
+
+   for (; Steps != 0; Steps--)
+   {
+      if (DepCacheState::Undo(*depcache,Journal->back()) == false)
+      {
+	 Journal->clear();
+	 PyErr_SetString(PyExc_ValueError,"The marks have been changed outside "
+			 "of the journal; it has been cleared");
+	 return 0;
+      }
+      Journal->pop_back();
+   }
+   Py_INCREF(Py_None);
+   return Py_None;
+}
+
+static PyObject *PkgDepCacheGetKeepJournal(PyObject *Self,void*)
+{
+   return PyBool_FromLong(((DepCacheObject<pkgDepCache *> *)Self)->Journal != 0);
+}
+
+static int PkgDepCacheSetKeepJournal(PyObject *Self,PyObject *Value,void*)
+{
+   if (Value == 0)
+   {
+      PyErr_SetString(PyExc_TypeError,"Cannot delete the keep_journal attribute");
+      return -1;
+   }
+   int Res = PyObject_IsTrue(Value);
+   if (Res == -1)
+      return -1;
+
+   DepCacheObject<pkgDepCache *> *Obj = (DepCacheObject<pkgDepCache *> *)Self;
+   if (Res == 1 && Obj->Journal == 0)
+      Obj->Journal = new std::vector<DepCacheState::Delta>;
+   else if (Res == 0)
+   {
+      delete Obj->Journal;
+      Obj->Journal = 0;
+   }
+   return 0;
+}
+
+static PyObject *PkgDepCacheGetJournalLength(PyObject *Self,void*)
+{
+   std::vector<DepCacheState::Delta> *Journal =
+      ((DepCacheObject<pkgDepCache *> *)Self)->Journal;
+   return Py_BuildValue("n",(Py_ssize_t)(Journal == 0 ? 0 : Journal->size()));
+}
+									/*}}}*/
+
 // DepCache Class								/*{{{*/
 // ---------------------------------------------------------------------
 
@@ -55,6 +574,7 @@ static PyObject *PkgDepCacheInit(PyObject *Self,PyObject *Args)
    }
 
    pkgApplyStatus(*depcache);
+   ClearJournal(Self);
 
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
@@ -198,7 +718,9 @@ static PyObject *PkgDepCacheSetCandidateVer(PyObject *Self,PyObject *Args)
    if(I.end()) {
       return HandleErrors(Py_BuildValue("b",false));
    }
+   JournalRecorder Recorder(Self);
    depcache->SetCandidateVersion(I);
+   Recorder.Finish();
 
    return HandleErrors(Py_BuildValue("b",true));
 }
@@ -219,11 +741,27 @@ static PyObject *PkgDepCacheGetCandidateVer(PyObject *Self,PyObject *Args)
       Py_INCREF(Py_None);
       return Py_None;
    }
-   CandidateObj = CppPyObject_NEW<pkgCache::VerIterator>(PackageObj,&PyVersion_Type,I);
+   CandidateObj = GetVersionObject(PackageObj,I);
 
    return CandidateObj;
 }
 
+static PyObject *PkgDepCacheCandidateTable(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   unsigned long Count = depcache->GetCache().HeaderP->PackageCount;
+
+   PyObject *Column = PyColumn_New('I',Count);
+   if (Column == 0)
+      return 0;
+   unsigned int *Data = (unsigned int *)PyColumn_Data(Column);
+   pkgDepCache::StateCache *States = DepCacheState::PackageStates(*depcache);
+   // 0xFFFFFFFF marks packages without a candidate, like in export_columns().
+   for (unsigned long I = 0; I < Count; I++)
+      Data[I] = States[I].CandidateVer == 0 ? 0xFFFFFFFF : States[I].CandidateVer->ID;
+   return Column;
+}
+
 static PyObject *PkgDepCacheUpgrade(PyObject *Self,PyObject *Args)
 {
    bool res;
@@ -233,14 +771,19 @@ static PyObject *PkgDepCacheUpgrade(PyObject *Self,PyObject *Args)
    if (PyArg_ParseTuple(Args,"|b",&distUpgrade) == 0)
       return 0;
 
+   JournalRecorder Recorder(Self);
+   SolverRun Run(*depcache,SolverStatsEnabled<pkgDepCache *>(Self));
    Py_BEGIN_ALLOW_THREADS
+   Run.BeginPhase();
    if(distUpgrade)
       res = pkgDistUpgrade(*depcache);
    else
       res = pkgAllUpgrade(*depcache);
+   Run.EndPhase(distUpgrade ? "dist_upgrade" : "upgrade");
    Py_END_ALLOW_THREADS
+   SolverStatsStore<pkgDepCache *>(Self,Run);
+   Recorder.Finish();
 
-   Py_INCREF(Py_None);
    return HandleErrors(Py_BuildValue("b",res));
 }
 
@@ -252,11 +795,16 @@ static PyObject *PkgDepCacheMinimizeUpgrade(PyObject *Self,PyObject *Args)
    if (PyArg_ParseTuple(Args,"") == 0)
       return 0;
 
+   JournalRecorder Recorder(Self);
+   SolverRun Run(*depcache,SolverStatsEnabled<pkgDepCache *>(Self));
    Py_BEGIN_ALLOW_THREADS
+   Run.BeginPhase();
    res = pkgMinimizeUpgrade(*depcache);
+   Run.EndPhase("minimize_upgrade");
    Py_END_ALLOW_THREADS
+   SolverStatsStore<pkgDepCache *>(Self,Run);
+   Recorder.Finish();
 
-   Py_INCREF(Py_None);
    return HandleErrors(Py_BuildValue("b",res));
 }
 
@@ -288,8 +836,18 @@ static PyObject *PkgDepCacheFixBroken(PyObject *Self,PyObject *Args)
    if (PyArg_ParseTuple(Args,"") == 0)
       return 0;
 
+   JournalRecorder Recorder(Self);
+   SolverRun Run(*depcache,SolverStatsEnabled<pkgDepCache *>(Self));
+   Py_BEGIN_ALLOW_THREADS
+   Run.BeginPhase();
    res &=pkgFixBroken(*depcache);
+   Run.EndPhase("fix_broken");
+   Run.BeginPhase();
    res &=pkgMinimizeUpgrade(*depcache);
+   Run.EndPhase("minimize_upgrade");
+   Py_END_ALLOW_THREADS
+   SolverStatsStore<pkgDepCache *>(Self,Run);
+   Recorder.Finish();
 
    return HandleErrors(Py_BuildValue("b",res));
 }
@@ -304,7 +862,9 @@ static PyObject *PkgDepCacheMarkKeep(PyObject *Self,PyObject *Args)
       return 0;
 
    pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(PackageObj);
+   JournalRecorder Recorder(Self);
    depcache->MarkKeep(Pkg);
+   Recorder.Finish();
 
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
@@ -320,7 +880,9 @@ static PyObject *PkgDepCacheSetReInstall(PyObject *Self,PyObject *Args)
       return 0;
 
    pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(PackageObj);
+   JournalRecorder Recorder(Self);
    depcache->SetReInstall(Pkg,value);
+   Recorder.Finish();
 
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
@@ -337,7 +899,9 @@ static PyObject *PkgDepCacheMarkDelete(PyObject *Self,PyObject *Args)
       return 0;
 
    pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(PackageObj);
+   JournalRecorder Recorder(Self);
    depcache->MarkDelete(Pkg,purge);
+   Recorder.Finish();
 
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
@@ -355,15 +919,111 @@ static PyObject *PkgDepCacheMarkInstall(PyObject *Self,PyObject *Args)
 			&autoInst, &fromUser) == 0)
       return 0;
 
+   JournalRecorder Recorder(Self);
    Py_BEGIN_ALLOW_THREADS
    pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(PackageObj);
    depcache->MarkInstall(Pkg, autoInst, 0, fromUser);
+   Recorder.Finish();
    Py_END_ALLOW_THREADS
 
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
 }
 
+// DepCache.mark_*_many() - Mark a list of packages			/*{{{*/
+// ---------------------------------------------------------------------
+/* The packages are all marked within one action group, so the cleanup
+   which is otherwise done after each change only happens once, at the end.
+   Packages can be given as Package objects or as package IDs. */
+static PyObject *PkgDepCacheMarkInstallMany(PyObject *Self,PyObject *Args,
+					    PyObject *kwds)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+
+   PyObject *Pkgs;
+   char autoInst=1;
+   char fromUser=1;
+   char *kwlist[] = {"pkgs","auto_inst","from_user",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O|bb",kwlist,&Pkgs,
+				   &autoInst,&fromUser) == 0)
+      return 0;
+
+   std::vector<pkgCache::Package *> List;
+   if (ParsePackageRefs(GetOwner<pkgDepCache *>(Self),Pkgs,List) == false)
+      return 0;
+
+   JournalRecorder Recorder(Self);
+   Py_BEGIN_ALLOW_THREADS
+   pkgDepCache::ActionGroup group(*depcache);
+   for (std::vector<pkgCache::Package *>::iterator I = List.begin();
+	I != List.end(); I++)
+      depcache->MarkInstall(pkgCache::PkgIterator(depcache->GetCache(),*I),
+			    autoInst,0,fromUser);
+   group.release();
+   Recorder.Finish();
+   Py_END_ALLOW_THREADS
+
+   Py_INCREF(Py_None);
+   return HandleErrors(Py_None);
+}
+
+static PyObject *PkgDepCacheMarkDeleteMany(PyObject *Self,PyObject *Args,
+					   PyObject *kwds)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+
+   PyObject *Pkgs;
+   char purge = 0;
+   char *kwlist[] = {"pkgs","purge",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O|b",kwlist,&Pkgs,&purge) == 0)
+      return 0;
+
+   std::vector<pkgCache::Package *> List;
+   if (ParsePackageRefs(GetOwner<pkgDepCache *>(Self),Pkgs,List) == false)
+      return 0;
+
+   JournalRecorder Recorder(Self);
+   Py_BEGIN_ALLOW_THREADS
+   pkgDepCache::ActionGroup group(*depcache);
+   for (std::vector<pkgCache::Package *>::iterator I = List.begin();
+	I != List.end(); I++)
+      depcache->MarkDelete(pkgCache::PkgIterator(depcache->GetCache(),*I),
+			   purge);
+   group.release();
+   Recorder.Finish();
+   Py_END_ALLOW_THREADS
+
+   Py_INCREF(Py_None);
+   return HandleErrors(Py_None);
+}
+
+static PyObject *PkgDepCacheMarkKeepMany(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+
+   PyObject *Pkgs;
+   if (PyArg_ParseTuple(Args,"O",&Pkgs) == 0)
+      return 0;
+
+   std::vector<pkgCache::Package *> List;
+   if (ParsePackageRefs(GetOwner<pkgDepCache *>(Self),Pkgs,List) == false)
+      return 0;
+
+   JournalRecorder Recorder(Self);
+   Py_BEGIN_ALLOW_THREADS
+   pkgDepCache::ActionGroup group(*depcache);
+   for (std::vector<pkgCache::Package *>::iterator I = List.begin();
+	I != List.end(); I++)
+      depcache->MarkKeep(pkgCache::PkgIterator(depcache->GetCache(),*I));
+   group.release();
+   Recorder.Finish();
+   Py_END_ALLOW_THREADS
+
+   Py_INCREF(Py_None);
+   return HandleErrors(Py_None);
+}
+									/*}}}*/
+
 static PyObject *PkgDepCacheMarkAuto(PyObject *Self,PyObject *Args)
 {
    pkgDepCache *depcache = GetCpp<pkgDepCache*>(Self);
@@ -374,7 +1034,9 @@ static PyObject *PkgDepCacheMarkAuto(PyObject *Self,PyObject *Args)
       return 0;
 
    pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(PackageObj);
+   JournalRecorder Recorder(Self);
    depcache->MarkAuto(Pkg,value);
+   Recorder.Finish();
 
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
@@ -540,11 +1202,362 @@ static PyObject *PkgDepCacheMarkedReinstall(PyObject *Self,PyObject *Args)
 }
 
 
+// DepCache.states() - The state of all packages at once		/*{{{*/
+// ---------------------------------------------------------------------
+/* Return the DepCacheStateFlags for the state of one package, combining the
+   answers of the marked_*() and is_*() methods. */
+static unsigned short PackageStateFlags(pkgDepCache::StateCache &State)
+{
+   unsigned short Flags = 0;
+   if (State.NewInstall())
+      Flags |= DepCacheStateInstall;
+   if (State.Upgrade())
+      Flags |= DepCacheStateUpgrade;
+   if (State.Delete())
+      Flags |= DepCacheStateDelete;
+   if (State.Keep())
+      Flags |= DepCacheStateKeep;
+   if (State.Downgrade())
+      Flags |= DepCacheStateDowngrade;
+   if (State.Install() && (State.iFlags & pkgDepCache::ReInstall))
+      Flags |= DepCacheStateReInstall;
+   if (State.Garbage)
+      Flags |= DepCacheStateGarbage;
+   if (State.NowBroken())
+      Flags |= DepCacheStateNowBroken;
+   if (State.InstBroken())
+      Flags |= DepCacheStateInstBroken;
+   if (State.Flags & pkgCache::Flag::Auto)
+      Flags |= DepCacheStateAuto;
+   if (State.Upgradable())
+      Flags |= DepCacheStateUpgradable;
+   return Flags;
+}
+
+static PyObject *PkgDepCacheStates(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   unsigned long Count = depcache->GetCache().HeaderP->PackageCount;
+
+   PyObject *Column = PyColumn_New('H',Count);
+   if (Column == 0)
+      return 0;
+   unsigned short *Data = (unsigned short *)PyColumn_Data(Column);
+   pkgDepCache::StateCache *States = DepCacheState::PackageStates(*depcache);
+   for (unsigned long I = 0; I < Count; I++)
+      Data[I] = PackageStateFlags(States[I]);
+   return Column;
+}
+
+static PyObject *PkgDepCacheChangedIds(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   int Mask = DepCacheStateChanged;
+   if (PyArg_ParseTuple(Args,"|i",&Mask) == 0)
+      return 0;
+
+   unsigned long Count = depcache->GetCache().HeaderP->PackageCount;
+   pkgDepCache::StateCache *States = DepCacheState::PackageStates(*depcache);
+   std::vector<unsigned int> IDs;
+   for (unsigned long I = 0; I < Count; I++)
+      if ((PackageStateFlags(States[I]) & Mask) != 0)
+	 IDs.push_back(I);
+
+   PyObject *Column = PyColumn_New('I',IDs.size());
+   if (Column == 0)
+      return 0;
+   if (IDs.empty() == false)
+      memcpy(PyColumn_Data(Column),&IDs[0],IDs.size() * sizeof(unsigned int));
+   return Column;
+}
+
+static PyObject *PkgDepCacheGarbageIds(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   pkgCache &Cache = depcache->GetCache();
+   unsigned long Count = Cache.HeaderP->PackageCount;
+   pkgDepCache::StateCache *States = DepCacheState::PackageStates(*depcache);
+   std::vector<unsigned int> IDs;
+   for (pkgCache::PkgIterator Pkg = Cache.PkgBegin(); Pkg.end() == false; Pkg++)
+      if (Pkg->ID < Count && States[Pkg->ID].Garbage &&
+	  Pkg->CurrentVer != 0)
+	 IDs.push_back(Pkg->ID);
+   std::sort(IDs.begin(),IDs.end());
+
+   PyObject *Column = PyColumn_New('I',IDs.size());
+   if (Column == 0)
+      return 0;
+   if (IDs.empty() == false)
+      memcpy(PyColumn_Data(Column),&IDs[0],IDs.size() * sizeof(unsigned int));
+   return Column;
+}
+									/*}}}*/
+
+// DepCache.size_deltas() - Sizes of the changes per package		/*{{{*/
+// ---------------------------------------------------------------------
+/* Compute the download size and the change of the installed size caused
+   by the state of Pkg, the same way pkgDepCache::AddSizes() accumulates
+   them into DebSize() and UsrSize(). Returns false if the package does not
+   contribute to either. */
+static bool PackageSizeDelta(pkgDepCache &Cache,pkgCache::PkgIterator const &Pkg,
+			     unsigned long long &Download,long long &Installed)
+{
+   pkgDepCache::StateCache &State = Cache[Pkg];
+   Download = 0;
+   Installed = 0;
+   if (State.NewInstall() == true)
+   {
+      pkgCache::VerIterator Ver = State.InstVerIter(Cache);
+      Installed = Ver->InstalledSize;
+      Download = Ver->Size;
+      return true;
+   }
+   // Upgrading, downgrading or reinstalling
+   if (Pkg->CurrentVer != 0 && State.InstallVer != 0 &&
+       (State.InstallVer != (pkgCache::Version *)Pkg.CurrentVer() ||
+	(State.iFlags & pkgDepCache::ReInstall) == pkgDepCache::ReInstall))
+   {
+      pkgCache::VerIterator Ver = State.InstVerIter(Cache);
+      Installed = (long long)Ver->InstalledSize - (long long)Pkg.CurrentVer()->InstalledSize;
+      Download = Ver->Size;
+      return true;
+   }
+   // Reinstalling a package which has only been unpacked
+   if (Pkg.State() == pkgCache::PkgIterator::NeedsUnpack &&
+       State.Delete() == false && State.InstallVer != 0)
+   {
+      Download = State.InstVerIter(Cache)->Size;
+      return true;
+   }
+   // Removing
+   if (Pkg->CurrentVer != 0 && State.InstallVer == 0)
+   {
+      Installed = -(long long)Pkg.CurrentVer()->InstalledSize;
+      return true;
+   }
+   return false;
+}
+
+static PyObject *PkgDepCacheSizeDeltas(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   pkgCache &Cache = depcache->GetCache();
+
+   std::vector<unsigned int> IDs;
+   std::vector<unsigned long long> Downloads;
+   std::vector<long long> Installs;
+   for (pkgCache::PkgIterator Pkg = Cache.PkgBegin(); Pkg.end() == false; Pkg++)
+   {
+      unsigned long long Download;
+      long long Installed;
+      if (PackageSizeDelta(*depcache,Pkg,Download,Installed) == false)
+	 continue;
+      IDs.push_back(Pkg->ID);
+      Downloads.push_back(Download);
+      Installs.push_back(Installed);
+   }
+
+   PyObject *IDColumn = PyColumn_New('I',IDs.size());
+   PyObject *DownloadColumn = PyColumn_New('Q',IDs.size());
+   PyObject *InstallColumn = PyColumn_New('q',IDs.size());
+   if (IDColumn == 0 || DownloadColumn == 0 || InstallColumn == 0)
+   {
+      Py_XDECREF(IDColumn);
+      Py_XDECREF(DownloadColumn);
+      Py_XDECREF(InstallColumn);
+      return 0;
+   }
+   // Sort the three columns by package ID.
+   std::vector<std::pair<unsigned int,size_t> > Order(IDs.size());
+   for (size_t I = 0; I != IDs.size(); I++)
+      Order[I] = std::make_pair(IDs[I],I);
+   std::sort(Order.begin(),Order.end());
+   for (size_t I = 0; I != Order.size(); I++)
+   {
+      PyColumn_SetItem(IDColumn,I,Order[I].first);
+      PyColumn_SetItem(DownloadColumn,I,Downloads[Order[I].second]);
+      PyColumn_SetItem(InstallColumn,I,Installs[Order[I].second]);
+   }
+   return Py_BuildValue("(NNN)",IDColumn,DownloadColumn,InstallColumn);
+}
+									/*}}}*/
+
+// DepCache.clone() - Independent copies of a depcache		/*{{{*/
+// ---------------------------------------------------------------------
+/* Create a new pkgDepCache for the same cache and policy as Cache, with a
+   copy of its marking state. The cache and the policy are shared, so
+   the clone must not outlive them. The state is copied instead of being
+   computed by Init(), so this costs about as much as a snapshot. */
+static pkgDepCache *CloneDepCache(pkgDepCache &Cache)
+{
+   pkgDepCache *Clone = new pkgDepCache(&Cache.GetCache(),&Cache.GetPolicy());
+   DepCacheState::Copy(*Clone,Cache);
+   return Clone;
+}
+
+static PyObject *PkgDepCacheClone(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   pkgDepCache *Clone = CloneDepCache(*depcache);
+
+   // Unlike the depcache of the cachefile, clones belong to their object.
+   return HandleErrors(CppPyObject_NEW<pkgDepCache *>(GetOwner<pkgDepCache *>(Self),
+						      &PyDepCache_Type,Clone));
+}
+
+struct EvaluateChunk
+{
+   pkgDepCache *Source;
+   std::string const *Base;
+   std::vector<pkgCache::Package *> const *Pkgs;
+   std::vector<std::vector<unsigned int> > *Results;
+   // The messages of each package, the error stack belongs to the thread.
+   std::vector<SavedErrors> *Errors;
+   size_t First;
+   size_t Step;
+};
+
+/* Evaluate every Step-th package, starting at First, on the worker's own
+   clone of Source, resetting it to the base state before each package. */
+static void *EvaluateWorker(void *Arg)
+{
+   EvaluateChunk *Chunk = (EvaluateChunk *)Arg;
+   pkgDepCache *Cache = CloneDepCache(*Chunk->Source);
+   for (size_t I = Chunk->First; I < Chunk->Pkgs->size(); I += Chunk->Step)
+   {
+      DepCacheState::Restore(*Cache,*Chunk->Base);
+      Cache->MarkInstall(pkgCache::PkgIterator(Cache->GetCache(),(*Chunk->Pkgs)[I]),
+			 true,0,true);
+      DepCacheState::ChangedIds(*Cache,*Chunk->Base,(*Chunk->Results)[I]);
+      SaveErrors((*Chunk->Errors)[I]);
+   }
+   delete Cache;
+   return 0;
+}
+
+char *doc_EvaluateInstalls =
+    "evaluate_installs(depcache: DepCache, pkgs: list[, threads=0]) -> list\n\n"
+    "For each package in pkgs (Package objects or IDs), mark it for install\n"
+    "on a clone of depcache and return the IDs of all packages whose state\n"
+    "would change, as a list of Column objects in the order of pkgs.\n"
+    "Each package is evaluated on its own, starting from the state of\n"
+    "depcache, which is not modified. The evaluation runs on 'threads'\n"
+    "threads (default: one per CPU) without holding the global interpreter\n"
+    "lock.";
+PyObject *EvaluateInstalls(PyObject *Self,PyObject *Args,PyObject *kwds)
+{
+   PyObject *DepCacheObj;
+   PyObject *PkgsObj;
+   int Threads = 0;
+   char *kwlist[] = {"depcache","pkgs","threads",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O!O|i",kwlist,&PyDepCache_Type,
+				   &DepCacheObj,&PkgsObj,&Threads) == 0)
+      return 0;
+
+   pkgDepCache *Base = GetCpp<pkgDepCache *>(DepCacheObj);
+   std::vector<pkgCache::Package *> Pkgs;
+   if (ParsePackageRefs(GetOwner<pkgDepCache *>(DepCacheObj),PkgsObj,Pkgs) == false)
+      return 0;
+
+   if (Threads <= 0)
+      Threads = sysconf(_SC_NPROCESSORS_ONLN);
+   if (Threads <= 0)
+      Threads = 1;
+   if ((size_t)Threads > Pkgs.size())
+      Threads = Pkgs.size() > 0 ? Pkgs.size() : 1;
+
+   std::vector<std::vector<unsigned int> > Results(Pkgs.size());
+   std::vector<SavedErrors> Errors(Pkgs.size());
+   Py_BEGIN_ALLOW_THREADS
+   // The first chunk runs in this thread; keep the messages which are
+   // already pending apart from the ones of its packages.
+   SavedErrors Pending;
+   SaveErrors(Pending);
+
+   std::string BaseState = DepCacheState::Save(*Base);
+   std::vector<EvaluateChunk> Chunks(Threads);
+   std::vector<pthread_t> Workers(Threads);
+   std::vector<bool> Started(Threads,false);
+   for (int I = 0; I != Threads; I++)
+   {
+      Chunks[I].Source = Base;
+      Chunks[I].Base = &BaseState;
+      Chunks[I].Pkgs = &Pkgs;
+      Chunks[I].Results = &Results;
+      Chunks[I].Errors = &Errors;
+      Chunks[I].First = I;
+      Chunks[I].Step = Threads;
+      // Run the first chunk in this thread, and any chunk whose thread
+      // could not be started.
+      if (I != 0 && pthread_create(&Workers[I],0,EvaluateWorker,&Chunks[I]) == 0)
+	 Started[I] = true;
+   }
+   for (int I = 0; I != Threads; I++)
+      if (Started[I] == false)
+	 EvaluateWorker(&Chunks[I]);
+   for (int I = 0; I != Threads; I++)
+      if (Started[I] == true)
+	 pthread_join(Workers[I],0);
+
+   // Put back the pending messages, followed by the ones of the workers in
+   // the order of the packages.
+   for (size_t I = 0; I != Errors.size(); I++)
+      Pending.insert(Pending.end(),Errors[I].begin(),Errors[I].end());
+   RestoreErrors(Pending);
+   Py_END_ALLOW_THREADS
+
+   PyObject *List = PyList_New(Results.size());
+   for (size_t I = 0; I != Results.size(); I++)
+   {
+      PyObject *Column = PyColumn_New('I',Results[I].size());
+      if (Column == 0)
+      {
+	 Py_DECREF(List);
+	 return 0;
+      }
+      if (Results[I].empty() == false)
+	 memcpy(PyColumn_Data(Column),&Results[I][0],
+		Results[I].size() * sizeof(unsigned int));
+      PyList_SET_ITEM(List,I,Column);
+   }
+   return HandleErrors(List);
+}
+									/*}}}*/
+
+static PyObject *PkgDepCacheSnapshot(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   PyObject *Owner = GetOwner<pkgDepCache *>(Self);
+   return CppPyObject_NEW<std::string>(Owner,&PyDepCacheSnapshot_Type,
+				       DepCacheState::Save(*depcache));
+}
+
+static PyObject *PkgDepCacheRestore(PyObject *Self,PyObject *Args)
+{
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(Self);
+   PyObject *Snapshot;
+   if (PyArg_ParseTuple(Args,"O!",&PyDepCacheSnapshot_Type,&Snapshot) == 0)
+      return 0;
+
+   if (DepCacheState::Restore(*depcache,GetCpp<std::string>(Snapshot)) == false)
+   {
+      PyErr_SetString(PyExc_ValueError,"The snapshot does not belong to this cache");
+      return 0;
+   }
+   ClearJournal(Self);
+   Py_INCREF(Py_None);
+   return Py_None;
+}
+
 static PyMethodDef PkgDepCacheMethods[] =
 {
    {"init",PkgDepCacheInit,METH_VARARGS,"Init the depcache (done on construct automatically)"},
    {"get_candidate_ver",PkgDepCacheGetCandidateVer,METH_VARARGS,"Get candidate version"},
    {"set_candidate_ver",PkgDepCacheSetCandidateVer,METH_VARARGS,"Set candidate version"},
+   {"candidate_table",PkgDepCacheCandidateTable,METH_NOARGS,
+    "candidate_table() -> Column\n\n"
+    "Return the IDs of the candidate versions of all packages, indexed by\n"
+    "package ID, with 0xFFFFFFFF for packages without a candidate."},
 
    // global cache operations
    {"upgrade",PkgDepCacheUpgrade,METH_VARARGS,"Perform Upgrade (optional boolean argument if dist-upgrade should be performed)"},
@@ -557,6 +1570,17 @@ static PyMethodDef PkgDepCacheMethods[] =
    {"mark_install",PkgDepCacheMarkInstall,METH_VARARGS,"Mark package for Install"},
    {"mark_auto",PkgDepCacheMarkAuto,METH_VARARGS,"mark_auto(pkg: apt_pkg.Package, auto: bool)\n\nMark package as automatically installed."},
    {"set_reinstall",PkgDepCacheSetReInstall,METH_VARARGS,"Set if the package should be reinstalled"},
+   {"mark_install_many",(PyCFunction)PkgDepCacheMarkInstallMany,
+    METH_VARARGS|METH_KEYWORDS,
+    "mark_install_many(pkgs: list[, auto_inst=True[, from_user=True]])\n\n"
+    "Mark the given packages (Package objects or IDs) for install."},
+   {"mark_delete_many",(PyCFunction)PkgDepCacheMarkDeleteMany,
+    METH_VARARGS|METH_KEYWORDS,
+    "mark_delete_many(pkgs: list[, purge=False])\n\n"
+    "Mark the given packages (Package objects or IDs) for delete."},
+   {"mark_keep_many",PkgDepCacheMarkKeepMany,METH_VARARGS,
+    "mark_keep_many(pkgs: list)\n\n"
+    "Mark the given packages (Package objects or IDs) for keep."},
    // state information
    {"is_upgradable",PkgDepCacheIsUpgradable,METH_VARARGS,"Is pkg upgradable"},
    {"is_now_broken",PkgDepCacheIsNowBroken,METH_VARARGS,"Is pkg is now broken"},
@@ -569,8 +1593,39 @@ static PyMethodDef PkgDepCacheMethods[] =
    {"marked_keep",PkgDepCacheMarkedKeep,METH_VARARGS,"Is pkg marked for keep"},
    {"marked_reinstall",PkgDepCacheMarkedReinstall,METH_VARARGS,"Is pkg marked for reinstall"},
    {"marked_downgrade",PkgDepCacheMarkedDowngrade,METH_VARARGS,"Is pkg marked for downgrade"},
+   {"states",PkgDepCacheStates,METH_NOARGS,
+    "states() -> Column\n\n"
+    "Return the state of all packages as a column of STATE_* flags,\n"
+    "indexed by package ID."},
+   {"size_deltas",PkgDepCacheSizeDeltas,METH_NOARGS,
+    "size_deltas() -> (Column, Column, Column)\n\n"
+    "Return the IDs of all packages contributing to deb_size or usr_size,\n"
+    "their download sizes and the changes of their installed sizes."},
+   {"garbage_ids",PkgDepCacheGarbageIds,METH_NOARGS,
+    "garbage_ids() -> Column\n\n"
+    "Return the IDs of all installed packages which are garbage, i.e.\n"
+    "which can be removed automatically, in ascending order."},
+   {"changed_ids",PkgDepCacheChangedIds,METH_VARARGS,
+    "changed_ids([mask: int = STATE_CHANGED]) -> Column\n\n"
+    "Return the IDs of all packages whose state has any flag of mask set."},
    // Action
    {"commit", PkgDepCacheCommit, METH_VARARGS, "Commit pending changes"},
+   // Saving and restoring the marking state
+   {"undo",PkgDepCacheUndo,METH_VARARGS,
+    "undo([steps: int = 1])\n\n"
+    "Revert the last marking operations recorded in the journal, see\n"
+    "keep_journal."},
+   {"clone",PkgDepCacheClone,METH_NOARGS,
+    "clone() -> DepCache\n\n"
+    "Return a new, independent DepCache with a copy of the marking state,\n"
+    "sharing the cache and the policy with this one."},
+   {"snapshot",PkgDepCacheSnapshot,METH_NOARGS,
+    "snapshot() -> DepCacheSnapshot\n\n"
+    "Save the marking state of all packages and the counters, for\n"
+    "restoring them later with restore()."},
+   {"restore",PkgDepCacheRestore,METH_VARARGS,
+    "restore(snapshot: DepCacheSnapshot)\n\n"
+    "Restore the marking state saved by snapshot()."},
    {}
 };
 
@@ -615,6 +1670,15 @@ static PyGetSetDef PkgDepCacheGetSet[] = {
     {"keep_count",PkgDepCacheGetKeepCount},
     {"usr_size",PkgDepCacheGetUsrSize},
     {"policy",PkgDepCacheGetPolicy},
+    {"collect_stats",SolverGetCollectStats<pkgDepCache *>,
+     SolverSetCollectStats<pkgDepCache *>,
+     "Whether to record statistics about solver runs in stats."},
+    {"stats",SolverGetStats<pkgDepCache *>,0,
+     "Statistics about the last solver run, or None."},
+    {"keep_journal",PkgDepCacheGetKeepJournal,PkgDepCacheSetKeepJournal,
+     "Whether to record the marking operations, for undo()."},
+    {"journal_length",PkgDepCacheGetJournalLength,0,
+     "The number of marking operations which can be undone."},
     {}
 };
 
@@ -631,8 +1695,14 @@ static PyObject *PkgDepCacheNew(PyTypeObject *type,PyObject *Args,PyObject *kwds
    PyObject *CacheFilePy = GetOwner<pkgCache*>(Owner);
    // get the pkgCacheFile from the cachefile
    pkgCacheFile *CacheF = GetCpp<pkgCacheFile*>(CacheFilePy);
-   // and now the depcache
-   pkgDepCache *depcache = (pkgDepCache *)(*CacheF);
+   // and now the depcache, read-only caches create it on demand
+   pkgDepCache *depcache;
+   if (((PkgCacheData *)Owner)->ReadOnly == true)
+      depcache = ReadOnlyCacheFile::GetDepCache(*CacheF);
+   else
+      depcache = (pkgDepCache *)(*CacheF);
+   if (depcache == 0)
+      return HandleErrors();
 
    CppPyObject<pkgDepCache*> *DepCachePyObj;
    DepCachePyObj = CppPyObject_NEW<pkgDepCache*>(Owner,type,depcache);
@@ -650,10 +1720,10 @@ PyTypeObject PyDepCache_Type =
 {
    PyVarObject_HEAD_INIT(&PyType_Type, 0)
    "apt_pkg.DepCache",                  // tp_name
-   sizeof(CppPyObject<pkgDepCache *>),   // tp_basicsize
+   sizeof(DepCacheObject<pkgDepCache *>), // tp_basicsize
    0,                                   // tp_itemsize
    // Methods
-   CppDeallocPtr<pkgDepCache *>,   // tp_dealloc
+   DepCacheObjectDealloc<pkgDepCache *>,   // tp_dealloc
    0,                                   // tp_print
    0,                                   // tp_getattr
    0,                                   // tp_setattr
@@ -691,6 +1761,53 @@ PyTypeObject PyDepCache_Type =
    PkgDepCacheNew,                      // tp_new
 };
 
+static PyObject *DepCacheSnapshotGetSize(PyObject *Self,void*) {
+   return Py_BuildValue("n",(Py_ssize_t)GetCpp<std::string>(Self).size());
+}
+
+static PyGetSetDef DepCacheSnapshotGetSet[] = {
+    {"size",DepCacheSnapshotGetSize,0,"The size of the snapshot, in bytes."},
+    {}
+};
+
+static char *doc_DepCacheSnapshot = "The marking state of a DepCache, as\n"
+    "returned by DepCache.snapshot(). It can be restored into any DepCache\n"
+    "of the same cache using DepCache.restore().";
+PyTypeObject PyDepCacheSnapshot_Type =
+{
+   PyVarObject_HEAD_INIT(&PyType_Type, 0)
+   "apt_pkg.DepCacheSnapshot",          // tp_name
+   sizeof(CppPyObject<std::string>),    // tp_basicsize
+   0,                                   // tp_itemsize
+   // Methods
+   CppDealloc<std::string>,             // tp_dealloc
+   0,                                   // tp_print
+   0,                                   // tp_getattr
+   0,                                   // tp_setattr
+   0,                                   // tp_compare
+   0,                                   // tp_repr
+   0,                                   // tp_as_number
+   0,                                   // tp_as_sequence
+   0,                                   // tp_as_mapping
+   0,                                   // tp_hash
+   0,                                   // tp_call
+   0,                                   // tp_str
+   0,                                   // tp_getattro
+   0,                                   // tp_setattro
+   0,                                   // tp_as_buffer
+   Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC, // tp_flags
+   doc_DepCacheSnapshot,                // tp_doc
+   CppTraverse<std::string>,            // tp_traverse
+   CppClear<std::string>,               // tp_clear
+   0,                                   // tp_richcompare
+   0,                                   // tp_weaklistoffset
+   0,                                   // tp_iter
+   0,                                   // tp_iternext
+   0,                                   // tp_methods
+   0,                                   // tp_members
+   DepCacheSnapshotGetSet,              // tp_getset
+};
+
 #ifdef COMPAT_0_7
 PyObject *GetDepCache(PyObject *Self,PyObject *Args)
 {
@@ -746,9 +1863,17 @@ static PyObject *PkgProblemResolverResolve(PyObject *Self,PyObject *Args)
    if (PyArg_ParseTuple(Args,"|b",&brokenFix) == 0)
       return 0;
 
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(GetOwner<pkgProblemResolver *>(Self));
+   // The changes are part of the journal of the DepCache object.
+   JournalRecorder Recorder(GetOwner<pkgProblemResolver *>(Self));
+   SolverRun Run(*depcache,SolverStatsEnabled<pkgProblemResolver *>(Self));
    Py_BEGIN_ALLOW_THREADS
+   Run.BeginPhase();
    res = fixer->Resolve(brokenFix);
+   Run.EndPhase("resolve");
    Py_END_ALLOW_THREADS
+   SolverStatsStore<pkgProblemResolver *>(Self,Run);
+   Recorder.Finish();
 
    return HandleErrors(Py_BuildValue("b", res));
 }
@@ -760,9 +1885,17 @@ static PyObject *PkgProblemResolverResolveByKeep(PyObject *Self,PyObject *Args)
    if (PyArg_ParseTuple(Args,"") == 0)
       return 0;
 
+   pkgDepCache *depcache = GetCpp<pkgDepCache *>(GetOwner<pkgProblemResolver *>(Self));
+   // The changes are part of the journal of the DepCache object.
+   JournalRecorder Recorder(GetOwner<pkgProblemResolver *>(Self));
+   SolverRun Run(*depcache,SolverStatsEnabled<pkgProblemResolver *>(Self));
    Py_BEGIN_ALLOW_THREADS
+   Run.BeginPhase();
    res = fixer->ResolveByKeep();
+   Run.EndPhase("resolve_by_keep");
    Py_END_ALLOW_THREADS
+   SolverStatsStore<pkgProblemResolver *>(Self,Run);
+   Recorder.Finish();
 
    return HandleErrors(Py_BuildValue("b", res));
 }
@@ -775,6 +1908,7 @@ static PyObject *PkgProblemResolverProtect(PyObject *Self,PyObject *Args)
       return 0;
    pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(PackageObj);
    fixer->Protect(Pkg);
+   ((DepCacheObject<pkgProblemResolver *> *)Self)->ProtectCount++;
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
 
@@ -787,6 +1921,7 @@ static PyObject *PkgProblemResolverRemove(PyObject *Self,PyObject *Args)
       return 0;
    pkgCache::PkgIterator &Pkg = GetCpp<pkgCache::PkgIterator>(PackageObj);
    fixer->Remove(Pkg);
+   ((DepCacheObject<pkgProblemResolver *> *)Self)->RemoveCount++;
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
 }
@@ -827,14 +1962,23 @@ static PyMethodDef PkgProblemResolverMethods[] =
    {}
 };
 
+static PyGetSetDef PkgProblemResolverGetSet[] = {
+    {"collect_stats",SolverGetCollectStats<pkgProblemResolver *>,
+     SolverSetCollectStats<pkgProblemResolver *>,
+     "Whether to record statistics about solver runs in stats."},
+    {"stats",SolverGetStats<pkgProblemResolver *>,0,
+     "Statistics about the last solver run, or None."},
+    {}
+};
+
 PyTypeObject PyProblemResolver_Type =
 {
    PyVarObject_HEAD_INIT(&PyType_Type, 0)
    "apt_pkg.ProblemResolver",                       // tp_name
-   sizeof(CppPyObject<pkgProblemResolver *>),   // tp_basicsize
+   sizeof(DepCacheObject<pkgProblemResolver *>), // tp_basicsize
    0,                                   // tp_itemsize
    // Methods
-   CppDeallocPtr<pkgProblemResolver *>,// tp_dealloc
+   DepCacheObjectDealloc<pkgProblemResolver *>, // tp_dealloc
    0,                                   // tp_print
    0,                                   // tp_getattr
    0,                                   // tp_setattr
@@ -861,7 +2005,7 @@ PyTypeObject PyProblemResolver_Type =
    0,                                   // tp_iternext
    PkgProblemResolverMethods,           // tp_methods
    0,                                   // tp_members
-   0,                                   // tp_getset
+   PkgProblemResolverGetSet,            // tp_getset
    0,                                   // tp_base
    0,                                   // tp_dict
    0,                                   // tp_descr_get
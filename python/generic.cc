@@ -49,6 +49,28 @@ PyObject *HandleErrors(PyObject *Res)
    return 0;
 }
 
+void SaveErrors(SavedErrors &Saved)
+{
+   while (_error->empty() == false)
+   {
+      string Msg;
+      bool Type = _error->PopMessage(Msg);
+      Saved.push_back(make_pair(Type,Msg));
+   }
+}
+
+void RestoreErrors(SavedErrors const &Saved)
+{
+   _error->Discard();
+   for (SavedErrors::const_iterator I = Saved.begin(); I != Saved.end(); I++)
+   {
+      if (I->first == true)
+	 _error->Error("%s",I->second.c_str());
+      else
+	 _error->Warning("%s",I->second.c_str());
+   }
+}
+
 # ifdef COMPAT_0_7
 // Helpers for deprecation.
 
@@ -29,6 +29,8 @@
 
 #include <Python.h>
 #include <string>
+#include <vector>
+#include <utility>
 #include <iostream>
 #include <new>
 #include <cstdlib>
@@ -56,6 +58,7 @@ typedef int Py_ssize_t;
 #define PyString_AsString PyUnicode_AsString
 #define PyString_FromFormat PyUnicode_FromFormat
 #define PyString_Type PyUnicode_Type
+#define PyString_InternInPlace PyUnicode_InternInPlace
 #define PyInt_Check PyLong_Check
 #define PyInt_AsLong PyLong_AsLong
 // Force 0.7 compatibility to be off in Python 3 builds
@@ -72,6 +75,14 @@ typedef int Py_ssize_t;
 #endif
 #endif
 
+// The new buffer protocol (PEP 3118) is available since Python 2.6.
+#if PY_MAJOR_VERSION >= 3 || (PY_MAJOR_VERSION == 2 && PY_MINOR_VERSION >= 6)
+#define HAVE_NEWBUFFER
+#endif
+#ifndef Py_TPFLAGS_HAVE_NEWBUFFER
+#define Py_TPFLAGS_HAVE_NEWBUFFER 0
+#endif
+
 // Hacks to make Python 2.4 build.
 #if PY_MAJOR_VERSION == 2 && PY_MINOR_VERSION <= 4
 #define PyErr_WarnEx(cat,msg,stacklevel) PyErr_Warn(cat,msg)
@@ -224,6 +235,13 @@ inline PyObject *Safe_FromString(const char *Str)
 // Convert _error into Python exceptions
 PyObject *HandleErrors(PyObject *Res = 0);
 
+// The messages of _error, as (is error, message) pairs in their order.
+typedef std::vector<std::pair<bool,std::string> > SavedErrors;
+// Move all messages of _error to the end of Saved.
+void SaveErrors(SavedErrors &Saved);
+// Replace the messages of _error by the ones in Saved.
+void RestoreErrors(SavedErrors const &Saved);
+
 // Convert a list of strings to a char **
 const char **ListToCharChar(PyObject *List,bool NullTerm = false);
 PyObject *CharCharToList(const char **List,unsigned long Size = 0);
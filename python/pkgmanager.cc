@@ -64,7 +64,7 @@ static PyObject *PkgManagerGetArchives(PyObject *Self,PyObject *Args)
    PkgRecordsStruct &s_records = GetCpp<PkgRecordsStruct>(recs);
 
    bool res = pm->GetArchives(s_fetcher, s_list,
-			      &s_records.Records);
+			      &s_records.GetRecords());
 
    return HandleErrors(Py_BuildValue("b",res));
 }
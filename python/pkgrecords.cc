@@ -12,14 +12,192 @@
 #include "apt_pkgmodule.h"
 #include "pkgrecords.h"
 
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/tagfile.h>
+#include <apt-pkg/strutl.h>
+#include <apt-pkg/indexfile.h>
 
 #include <Python.h>
+#include <langinfo.h>
+#include <algorithm>
+#include <vector>
 									/*}}}*/
 
 
+// MappedRecordParser - Parse records in the mapped index files	/*{{{*/
+// ---------------------------------------------------------------------
+/* The parser of PackageRecords(cache, mmap=True). Instead of seeking and
+   reading in a FileFd, the record is scanned in place in the map of its
+   index file. The fields are extracted like debRecordParser does. */
+class MappedRecordParser : public pkgRecords::Parser
+{
+   pkgTagSection Section;
+   // A copy of a record not followed by a blank line, i.e. the last one.
+   std::string Copy;
+
+   protected:
+   // Records are selected with Scan() only.
+   virtual bool Jump(pkgCache::VerFileIterator const &) {return false;};
+   virtual bool Jump(pkgCache::DescFileIterator const &) {return false;};
+
+   public:
+   bool Scan(const char *Start,unsigned long Size);
+
+   virtual std::string MD5Hash() {return Section.FindS("MD5Sum");};
+   virtual std::string SHA1Hash() {return Section.FindS("SHA1");};
+   virtual std::string SHA256Hash() {return Section.FindS("SHA256");};
+   virtual std::string SourcePkg();
+   virtual std::string SourceVer();
+   virtual std::string FileName() {return Section.FindS("Filename");};
+   virtual std::string Maintainer() {return Section.FindS("Maintainer");};
+   virtual std::string ShortDesc();
+   virtual std::string LongDesc();
+   virtual std::string Name() {return Section.FindS("Package");};
+   virtual std::string Homepage() {return Section.FindS("Homepage");};
+   virtual void GetRec(const char *&Start,const char *&Stop) {
+      Section.GetSection(Start,Stop);
+   };
+};
+
+bool MappedRecordParser::Scan(const char *Start,unsigned long Size)
+{
+   // pkgTagSection needs the blank line terminating the section.
+   if (Size < 2 || Start[Size - 2] != '\n' || Start[Size - 1] != '\n')
+   {
+      Copy.assign(Start,Size);
+      while (Copy.size() < 2 || Copy.compare(Copy.size() - 2,2,"\n\n") != 0)
+	 Copy += '\n';
+      Start = Copy.c_str();
+      Size = Copy.size();
+   }
+   return Section.Scan(Start,Size);
+}
+
+std::string MappedRecordParser::SourcePkg()
+{
+   std::string Res = Section.FindS("Source");
+   std::string::size_type Pos = Res.find(' ');
+   if (Pos == std::string::npos)
+      return Res;
+   return std::string(Res,0,Pos);
+}
+
+std::string MappedRecordParser::SourceVer()
+{
+   std::string Pkg = Section.FindS("Source");
+   std::string::size_type Pos = Pkg.find('(');
+   if (Pos == std::string::npos)
+      return std::string();
+   std::string::size_type End = Pkg.find(')',Pos);
+   if (End == std::string::npos)
+      return std::string();
+   return std::string(Pkg,Pos + 1,End - Pos - 1);
+}
+
+std::string MappedRecordParser::ShortDesc()
+{
+   std::string Res = LongDesc();
+   std::string::size_type Pos = Res.find('\n');
+   if (Pos == std::string::npos)
+      return Res;
+   return std::string(Res,0,Pos);
+}
+
+std::string MappedRecordParser::LongDesc()
+{
+   std::string Orig = Section.FindS("Description");
+   if (Orig.empty() == true)
+      Orig = Section.FindS(("Description-" + pkgIndexFile::LanguageCode()).c_str());
+
+   const char *Codeset = nl_langinfo(CODESET);
+   if (strcmp(Codeset,"UTF-8") != 0)
+   {
+      std::string Dest;
+      UTF8ToCodeset(Codeset,Orig,&Dest);
+      return Dest;
+   }
+   return Orig;
+}
+									/*}}}*/
+
 // PkgRecords Class							/*{{{*/
 // ---------------------------------------------------------------------
+PkgRecordsStruct::~PkgRecordsStruct()
+{
+   delete Mapped;
+   delete Records;
+   for (std::vector<MMap *>::iterator I = Maps.begin(); I != Maps.end(); I++)
+      delete *I;
+}
+
+// RecordData - Find a record in the mapped index file			/*{{{*/
+// ---------------------------------------------------------------------
+/* Map the index file of VerFile if needed and return the start and size of
+   the record in it, including the newline of the blank line separating it
+   from the next record. Returns NULL with an exception set on error. */
+static const char *RecordData(PkgRecordsStruct &Struct,pkgCache *Cache,
+			      pkgCache::VerFile *VerFile,unsigned long &Size)
+{
+   pkgCache::PkgFileIterator File(*Cache,Cache->PkgFileP + VerFile->File);
+   if (Struct.Maps.size() <= File->ID)
+      Struct.Maps.resize(File->ID + 1);
+   MMap *&Map = Struct.Maps[File->ID];
+   if (Map == 0)
+   {
+      FileFd Fd(File.FileName(),FileFd::ReadOnly);
+      if (_error->PendingError() == false)
+	 Map = new MMap(Fd,MMap::ReadOnly | MMap::Public);
+      if (_error->PendingError() == true)
+      {
+	 delete Map;
+	 Map = 0;
+	 HandleErrors();
+	 return 0;
+      }
+   }
 
+   // The offsets in the cache are only valid for the file it was built from.
+   if (Map->Size() != File->Size ||
+       Map->Size() < VerFile->Offset + VerFile->Size)
+   {
+      PyErr_Format(PyExc_IOError,"The index file %s has been modified",
+		   File.FileName());
+      return 0;
+   }
+
+   const char *Start = (const char *)Map->Data() + VerFile->Offset;
+   Size = VerFile->Size;
+   if (VerFile->Offset + Size < Map->Size() && Start[Size] == '\n')
+      Size++;
+   return Start;
+}
+									/*}}}*/
+// LookupRecord - Select a record					/*{{{*/
+// ---------------------------------------------------------------------
+/* Return the parser positioned at the record of VerFile, using the mapped
+   index files if the object has been created with mmap=True. Returns NULL
+   with an exception set on error. */
+static pkgRecords::Parser *LookupRecord(PkgRecordsStruct &Struct,pkgCache *Cache,
+					pkgCache::VerFile *VerFile)
+{
+   if (Struct.Mapped == 0)
+      return &Struct.GetRecords().Lookup(pkgCache::VerFileIterator(*Cache,VerFile));
+
+   unsigned long Size;
+   const char *Start = RecordData(Struct,Cache,VerFile,Size);
+   if (Start == 0)
+      return 0;
+   if (Struct.Mapped->Scan(Start,Size) == false)
+   {
+      pkgCache::PkgFileIterator File(*Cache,Cache->PkgFileP + VerFile->File);
+      PyErr_Format(PyExc_IOError,"Unable to parse the record at offset %lu of %s",
+		   (unsigned long)VerFile->Offset,File.FileName());
+      return 0;
+   }
+   return Struct.Mapped;
+}
+									/*}}}*/
 
 static PyObject *PkgRecordsLookup(PyObject *Self,PyObject *Args)
 {
@@ -41,15 +219,191 @@ static PyObject *PkgRecordsLookup(PyObject *Self,PyObject *Args)
    }
 
    // Do the lookup
-   Struct.Last = &Struct.Records.Lookup(pkgCache::VerFileIterator(*Cache,Cache->VerFileP+Index));
+   pkgRecords::Parser *Parser = LookupRecord(Struct,Cache,Cache->VerFileP+Index);
+   if (Parser == 0)
+      return 0;
+   Struct.LastFile = Cache->VerFileP+Index;
+   Struct.Last = Parser;
 
    // always return true (to make it consistent with the pkgsrcrecords object
    return Py_BuildValue("i", 1);
 }
 
+// PackageRecords.lookup_many() - Fields of many records at once	/*{{{*/
+// ---------------------------------------------------------------------
+/* The fields available through lookup_many(), named like the attributes.
+   The record itself has no getter of its own and is read with GetRec(). */
+struct RecordField
+{
+   const char *Name;
+   std::string (pkgRecords::Parser::*Get)();
+};
+
+static RecordField RecordFields[] = {
+   {"filename",&pkgRecords::Parser::FileName},
+   {"homepage",&pkgRecords::Parser::Homepage},
+   {"long_desc",&pkgRecords::Parser::LongDesc},
+   {"md5_hash",&pkgRecords::Parser::MD5Hash},
+   {"maintainer",&pkgRecords::Parser::Maintainer},
+   {"name",&pkgRecords::Parser::Name},
+   {"record",0},
+   {"sha1_hash",&pkgRecords::Parser::SHA1Hash},
+   {"sha256_hash",&pkgRecords::Parser::SHA256Hash},
+   {"short_desc",&pkgRecords::Parser::ShortDesc},
+   {"source_pkg",&pkgRecords::Parser::SourcePkg},
+   {"source_ver",&pkgRecords::Parser::SourceVer},
+   {}
+};
+
+static std::string GetRecordField(pkgRecords::Parser &Parser,RecordField const &Field)
+{
+   if (Field.Get != 0)
+      return (Parser.*Field.Get)();
+   const char *Start, *Stop;
+   Parser.GetRec(Start,Stop);
+   return std::string(Start,Stop - Start);
+}
+
+// Orders lookups by the file and the offset of their records.
+struct RecordLookup
+{
+   pkgCache::VerFile *File;
+   size_t Index;
+
+   bool operator <(RecordLookup const &Other) const
+   {
+      if (File->File != Other.File->File)
+	 return File->File < Other.File->File;
+      return File->Offset < Other.File->Offset;
+   }
+};
+
+static PyObject *PkgRecordsLookupMany(PyObject *Self,PyObject *Args,PyObject *kwds)
+{
+   PkgRecordsStruct &Struct = GetCpp<PkgRecordsStruct>(Self);
+   pkgCache *Cache = GetCpp<pkgCache *>(GetOwner<PkgRecordsStruct>(Self));
+
+   PyObject *FilesObj;
+   PyObject *FieldsObj;
+   char Columnar = 0;
+   char *kwlist[] = {"verfiles","fields","columnar",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"OO|b",kwlist,&FilesObj,
+				   &FieldsObj,&Columnar) == 0)
+      return 0;
+
+   std::vector<RecordField *> Fields;
+   PyObject *Seq = PySequence_Fast(FieldsObj,"fields must be a sequence");
+   if (Seq == 0)
+      return 0;
+   for (Py_ssize_t I = 0; I != PySequence_Fast_GET_SIZE(Seq); I++)
+   {
+      const char *Name;
+      if (PyArg_Parse(PySequence_Fast_GET_ITEM(Seq,I),"s;fields must be strings",
+		      &Name) == 0)
+      {
+	 Py_DECREF(Seq);
+	 return 0;
+      }
+      RecordField *Field = RecordFields;
+      for (; Field->Name != 0 && strcmp(Field->Name,Name) != 0; Field++);
+      if (Field->Name == 0)
+      {
+	 PyErr_Format(PyExc_ValueError,"Unknown field: %s",Name);
+	 Py_DECREF(Seq);
+	 return 0;
+      }
+      Fields.push_back(Field);
+   }
+   Py_DECREF(Seq);
+
+   std::vector<RecordLookup> Lookups;
+   Seq = PySequence_Fast(FilesObj,"verfiles must be a sequence");
+   if (Seq == 0)
+      return 0;
+   for (Py_ssize_t I = 0; I != PySequence_Fast_GET_SIZE(Seq); I++)
+   {
+      PyObject *PkgFObj;
+      long int Index;
+      if (PyArg_Parse(PySequence_Fast_GET_ITEM(Seq,I),
+		      "(O!l);verfiles must be (PackageFile, index) tuples",
+		      &PyPackageFile_Type,&PkgFObj,&Index) == 0)
+      {
+	 Py_DECREF(Seq);
+	 return 0;
+      }
+      // Same checks as in lookup()
+      pkgCache::PkgFileIterator &PkgF = GetCpp<pkgCache::PkgFileIterator>(PkgFObj);
+      if (PkgF.Cache() != Cache || Index < 0 ||
+	  Cache->DataEnd() <= Cache->VerFileP + Index + 1 ||
+	  Cache->VerFileP[Index].File != PkgF.Index())
+      {
+	 PyErr_SetNone(PyExc_IndexError);
+	 Py_DECREF(Seq);
+	 return 0;
+      }
+      RecordLookup Lookup = {Cache->VerFileP + Index,(size_t)I};
+      Lookups.push_back(Lookup);
+   }
+   Py_DECREF(Seq);
+
+   // Read the records in file order, so each file is read sequentially.
+   std::sort(Lookups.begin(),Lookups.end());
+   std::vector<std::string> Values(Lookups.size() * Fields.size());
+   bool Failed = false;
+   for (std::vector<RecordLookup>::iterator I = Lookups.begin();
+	I != Lookups.end() && Failed == false; I++)
+   {
+      pkgRecords::Parser *Parser = LookupRecord(Struct,Cache,I->File);
+      if (Parser == 0)
+      {
+	 Failed = true;
+	 break;
+      }
+      for (size_t F = 0; F != Fields.size(); F++)
+	 Values[I->Index * Fields.size() + F] = GetRecordField(*Parser,*Fields[F]);
+   }
+   // Go back to the record selected by lookup(), if any.
+   if (Struct.LastFile != 0)
+      Struct.Last = LookupRecord(Struct,Cache,Struct.LastFile);
+   if (Failed == true || (Struct.LastFile != 0 && Struct.Last == 0))
+      return 0;
+
+   PyObject *Result;
+   if (Columnar == true)
+   {
+      Result = PyDict_New();
+      for (size_t F = 0; F != Fields.size(); F++)
+      {
+	 PyObject *Column = PyList_New(Lookups.size());
+	 for (size_t I = 0; I != Lookups.size(); I++)
+	    PyList_SET_ITEM(Column,I,CppPyString(Values[I * Fields.size() + F]));
+	 PyDict_SetItemString(Result,Fields[F]->Name,Column);
+	 Py_DECREF(Column);
+      }
+   }
+   else
+   {
+      Result = PyList_New(Lookups.size());
+      for (size_t I = 0; I != Lookups.size(); I++)
+      {
+	 PyObject *Tuple = PyTuple_New(Fields.size());
+	 for (size_t F = 0; F != Fields.size(); F++)
+	    PyTuple_SET_ITEM(Tuple,F,CppPyString(Values[I * Fields.size() + F]));
+	 PyList_SET_ITEM(Result,I,Tuple);
+      }
+   }
+   return HandleErrors(Result);
+}
+									/*}}}*/
+
 static PyMethodDef PkgRecordsMethods[] =
 {
    {"lookup",PkgRecordsLookup,METH_VARARGS,"Changes to a new package"},
+   {"lookup_many",(PyCFunction)PkgRecordsLookupMany,METH_VARARGS|METH_KEYWORDS,
+    "lookup_many(verfiles: list, fields: list[, columnar=False]) -> list\n\n"
+    "Return the given fields of the records of all (PackageFile, index)\n"
+    "tuples in verfiles, as a list of tuples, or as a dict mapping each\n"
+    "field to a list of values if columnar is True."},
    {}
 };
 
@@ -116,6 +470,16 @@ static PyObject *PkgRecordsGetRecord(PyObject *Self,void*) {
    Struct.Last->GetRec(start, stop);
    return PyString_FromStringAndSize(start,stop-start);
 }
+static PyObject *PkgRecordsGetRecordView(PyObject *Self,void*) {
+   PkgRecordsStruct &Struct = GetStruct(Self,"RecordView");
+   if (Struct.Last == 0)
+      return 0;
+#if PY_MAJOR_VERSION >= 3 || PY_MINOR_VERSION >= 7
+   return PyMemoryView_FromObject(Self);
+#else
+   return PkgRecordsGetRecord(Self,0);
+#endif
+}
 static PyGetSetDef PkgRecordsGetSet[] = {
    {"filename",PkgRecordsGetFileName},
    {"homepage",PkgRecordsGetHomepage},
@@ -124,6 +488,8 @@ static PyGetSetDef PkgRecordsGetSet[] = {
    {"maintainer",PkgRecordsGetMaintainer},
    {"name",PkgRecordsGetName},
    {"record",PkgRecordsGetRecord},
+   {"record_view",PkgRecordsGetRecordView,0,
+    "A read-only memoryview of the current record in the index file."},
    {"sha1_hash",PkgRecordsGetSHA1Hash},
    {"sha256_hash",PkgRecordsGetSHA256Hash},
    {"short_desc",PkgRecordsGetShortDesc},
@@ -135,15 +501,56 @@ static PyGetSetDef PkgRecordsGetSet[] = {
 static PyObject *PkgRecordsNew(PyTypeObject *type,PyObject *Args,PyObject *kwds)
 {
    PyObject *Owner;
-   char *kwlist[] = {"cache",0};
-   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O!",kwlist,&PyCache_Type,
-                                   &Owner) == 0)
+   char Mapped = 0;
+   char *kwlist[] = {"cache","mmap",0};
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O!|b",kwlist,&PyCache_Type,
+                                   &Owner,&Mapped) == 0)
       return 0;
 
-   return HandleErrors(CppPyObject_NEW<PkgRecordsStruct>(Owner,type,
-							      GetCpp<pkgCache *>(Owner)));
+   CppPyObject<PkgRecordsStruct> *New;
+   New = CppPyObject_NEW<PkgRecordsStruct>(Owner,type,GetCpp<pkgCache *>(Owner));
+   // The mapped parser does not need the FileFd and parser of every index.
+   if (Mapped == true)
+      New->Object.Mapped = new MappedRecordParser;
+   else
+      New->Object.GetRecords();
+   return HandleErrors(New);
 }
 
+#ifdef HAVE_NEWBUFFER
+// The buffer of a PackageRecords object is the current record, as found in
+// the mapped index file. It stays valid when another record is looked up.
+static int PkgRecordsGetBuffer(PyObject *Self,Py_buffer *View,int Flags)
+{
+   PkgRecordsStruct &Struct = GetCpp<PkgRecordsStruct>(Self);
+   pkgCache *Cache = GetCpp<pkgCache *>(GetOwner<PkgRecordsStruct>(Self));
+   if (Struct.LastFile == 0)
+   {
+      PyErr_SetString(PyExc_BufferError,"No record has been looked up");
+      View->obj = 0;
+      return -1;
+   }
+
+   unsigned long Size;
+   const char *Data = RecordData(Struct,Cache,Struct.LastFile,Size);
+   if (Data == 0)
+   {
+      View->obj = 0;
+      return -1;
+   }
+   return PyBuffer_FillInfo(View,Self,(void *)Data,Size,1,Flags);
+}
+
+#if PY_MAJOR_VERSION >= 3
+static PyBufferProcs PkgRecordsBuffer = {PkgRecordsGetBuffer,0};
+#else
+static PyBufferProcs PkgRecordsBuffer = {0,0,0,0,PkgRecordsGetBuffer,0};
+#endif
+#define PKGRECORDS_BUFFER (&PkgRecordsBuffer)
+#else
+#define PKGRECORDS_BUFFER 0
+#endif
+
 PyTypeObject PyPackageRecords_Type =
 {
    PyVarObject_HEAD_INIT(&PyType_Type, 0)
@@ -165,9 +572,10 @@ PyTypeObject PyPackageRecords_Type =
    0,                                   // tp_str
    _PyAptObject_getattro,               // tp_getattro
    0,                                   // tp_setattro
-   0,                                   // tp_as_buffer
+   PKGRECORDS_BUFFER,                   // tp_as_buffer
    (Py_TPFLAGS_DEFAULT |                // tp_flags
     Py_TPFLAGS_BASETYPE |
+    Py_TPFLAGS_HAVE_NEWBUFFER |
     Py_TPFLAGS_HAVE_GC),
    "Records Object",                    // tp_doc
    CppTraverse<PkgRecordsStruct>,  // tp_traverse
@@ -1,10 +1,36 @@
 #include <apt-pkg/pkgrecords.h>
+#include <apt-pkg/mmap.h>
+#include <vector>
+
+class MappedRecordParser;
 
 struct PkgRecordsStruct
 {
-   pkgRecords Records;
+   pkgCache *Cache;
+   // The parsers of all index files, see GetRecords().
+   pkgRecords *Records;
    pkgRecords::Parser *Last;
+   // The file of the record Last points to.
+   pkgCache::VerFile *LastFile;
+   // Read-only maps of the index files, indexed by package file ID. They
+   // are created on first use and stay mapped until the object is gone,
+   // so buffers exported by record_view remain valid.
+   std::vector<MMap *> Maps;
+   // The parser used instead of Records by PackageRecords(cache, mmap=True),
+   // reading the records from Maps.
+   MappedRecordParser *Mapped;
+
+   PkgRecordsStruct(pkgCache *Cache) : Cache(Cache), Records(0), Last(0),
+                                       LastFile(0), Mapped(0) {};
+   PkgRecordsStruct() {abort();};  // G++ Bug..
+   ~PkgRecordsStruct();
 
-   PkgRecordsStruct(pkgCache *Cache) : Records(*Cache), Last(0) {};
-   PkgRecordsStruct() : Records(*(pkgCache *)0) {abort();};  // G++ Bug..
+   // Return Records, opening all index files on first use. In mmap mode,
+   // this only happens if the object is passed to other functions.
+   pkgRecords &GetRecords()
+   {
+      if (Records == 0)
+         Records = new pkgRecords(*Cache);
+      return *Records;
+   };
 };
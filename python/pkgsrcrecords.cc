@@ -12,29 +12,344 @@
 #include "apt_pkgmodule.h"
 
 #include <apt-pkg/sourcelist.h>
+#include <apt-pkg/metaindex.h>
+#include <apt-pkg/indexfile.h>
+#include <apt-pkg/error.h>
 
 #include <Python.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
 									/*}}}*/
 
+// A record in the Sources files, found by the parser with the given index.
+struct SrcRecordRef
+{
+   unsigned int Parser;
+   unsigned long Offset;
+};
+
+// A source or binary name of the record with the given number.
+struct SrcNameRef
+{
+   std::string Name;
+   unsigned int Record;
+
+   bool operator <(SrcNameRef const &Other) const {
+      int Res = Name.compare(Other.Name);
+      return Res < 0 || (Res == 0 && Record < Other.Record);
+   }
+};
+
+// The name index of the Sources files, see BuildIndex(). It has its own
+// parsers, one for each Sources file, in the order of pkgSrcRecords.
+struct SrcNameIndex
+{
+   std::vector<pkgSrcRecords::Parser *> Parsers;
+   // All records, in the order pkgSrcRecords::Find() visits them.
+   std::vector<SrcRecordRef> Index;
+   // The distinct source and binary names. The numbers of the records
+   // matching Names[I] are MatchList[MatchStart[I]] up to (excluding)
+   // MatchList[MatchStart[I + 1]], in ascending order.
+   std::vector<std::string> Names;
+   std::vector<unsigned int> MatchStart;
+   std::vector<unsigned int> MatchList;
+   // Open addressing hash table of indexes into Names, with a power of two
+   // size and 0xFFFFFFFF marking free slots. Empty until the index is built.
+   std::vector<unsigned int> NameTable;
+
+   void BuildNameTable(std::vector<SrcNameRef> &Refs);
+   bool FindName(const char *Name,unsigned int *&Begin,unsigned int *&End);
+   void swap(SrcNameIndex &Other) {
+      Parsers.swap(Other.Parsers);
+      Index.swap(Other.Index);
+      Names.swap(Other.Names);
+      MatchStart.swap(Other.MatchStart);
+      MatchList.swap(Other.MatchList);
+      NameTable.swap(Other.NameTable);
+   };
+
+   ~SrcNameIndex() {
+      for (std::vector<pkgSrcRecords::Parser *>::iterator I = Parsers.begin();
+	   I != Parsers.end(); I++)
+	 delete *I;
+   };
+};
+
 struct PkgSrcRecordsStruct
 {
    pkgSourceList List;
    pkgSrcRecords *Records;
    pkgSrcRecords::Parser *Last;
 
-   PkgSrcRecordsStruct() : Last(0) {
+   // Whether lookup() uses the name index instead of Records. This is the
+   // case for SourceRecords(index=True), which has no Records at all.
+   bool Indexed;
+   SrcNameIndex NameIndex;
+   // The number of the first record the next indexed lookup() may return.
+   unsigned int Next;
+   // The number of threads reading the Sources files in BuildIndex(), or
+   // 0 for one per CPU.
+   int Threads;
+
+   bool BuildIndex();
+
+   // The index of an Indexed object is built separately by BuildIndex().
+   PkgSrcRecordsStruct(bool Indexed = false) : Records(0), Last(0),
+                                               Indexed(Indexed), Next(0),
+                                               Threads(1) {
       List.ReadMainList();
-      Records = new pkgSrcRecords(List);
+      if (Indexed == false)
+	 Records = new pkgSrcRecords(List);
    };
    ~PkgSrcRecordsStruct() {
       delete Records;
    };
 };
 
+// Case sensitive FNV-1a hash, pkgSrcRecords::Find() compares names exactly.
+static inline unsigned long SrcNameHash(const char *Name)
+{
+   unsigned long Hash = 2166136261UL;
+   for (; *Name != 0; Name++)
+      Hash = ((Hash ^ (unsigned char)*Name) * 16777619UL) & 0xFFFFFFFFUL;
+   return Hash;
+}
+
+// ScanSources - Collect the records and names of a Sources file	/*{{{*/
+// ---------------------------------------------------------------------
+/* The records are numbered from zero, in the order of the file. */
+static bool ScanSources(pkgSrcRecords::Parser *Parser,unsigned int ParserIndex,
+			std::vector<SrcRecordRef> &Records,
+			std::vector<SrcNameRef> &Refs)
+{
+   if (Parser->Restart() == false)
+      return false;
+   while (Parser->Step() == true)
+   {
+      SrcRecordRef Record = {ParserIndex,Parser->Offset()};
+      SrcNameRef Ref;
+      Ref.Record = Records.size();
+      Records.push_back(Record);
+
+      Ref.Name = Parser->Package();
+      Refs.push_back(Ref);
+      std::string const Package = Ref.Name;
+      for (const char **B = Parser->Binaries(); B != 0 && *B != 0; B++)
+      {
+	 if (Package == *B)
+	    continue;
+	 Ref.Name = *B;
+	 Refs.push_back(Ref);
+      }
+   }
+   return _error->PendingError() == false;
+}
+									/*}}}*/
+// ScanWorker - Scan Sources files in a thread				/*{{{*/
+// ---------------------------------------------------------------------
+/* The workers take the next unscanned file until all are done. Every file
+   has its own results, so they can be merged in the order of the files no
+   matter which thread scanned them. */
+struct SrcScanJob
+{
+   std::vector<pkgSrcRecords::Parser *> *Parsers;
+   std::vector<std::vector<SrcRecordRef> > Records;
+   std::vector<std::vector<SrcNameRef> > Refs;
+   std::vector<char> Failed;
+   std::vector<SavedErrors> Errors;
+
+   pthread_mutex_t Lock;
+   unsigned int NextFile;
+};
+
+static void *ScanWorker(void *Arg)
+{
+   SrcScanJob *Job = (SrcScanJob *)Arg;
+   while (true)
+   {
+      pthread_mutex_lock(&Job->Lock);
+      unsigned int P = Job->NextFile++;
+      pthread_mutex_unlock(&Job->Lock);
+      if (P >= Job->Parsers->size())
+	 break;
+
+      if (ScanSources((*Job->Parsers)[P],P,Job->Records[P],Job->Refs[P]) == false)
+	 Job->Failed[P] = true;
+      // The error stack belongs to this thread, pass the messages on.
+      SaveErrors(Job->Errors[P]);
+   }
+   return 0;
+}
+									/*}}}*/
+// PkgSrcRecordsStruct::BuildIndex - Build the name index		/*{{{*/
+// ---------------------------------------------------------------------
+/* Every Sources file is read once, on Threads threads without holding the
+   global interpreter lock. A name can then be looked up in constant time,
+   returning its records in the order of a sequential Find().
+
+   The index is built separately and only replaces NameIndex once the lock is
+   held again, as another Python thread may use this object meanwhile. */
+bool PkgSrcRecordsStruct::BuildIndex()
+{
+   SrcNameIndex New;
+   std::vector<pkgSrcRecords::Parser *> &Parsers = New.Parsers;
+
+   // Create the parsers like pkgSrcRecords does
+   for (pkgSourceList::const_iterator I = List.begin(); I != List.end(); I++)
+   {
+      std::vector<pkgIndexFile *> *Indexes = (*I)->GetIndexFiles();
+      for (std::vector<pkgIndexFile *>::const_iterator J = Indexes->begin();
+	   J != Indexes->end(); J++)
+      {
+	 pkgSrcRecords::Parser *Parser = (*J)->CreateSrcParser();
+	 if (_error->PendingError() == true)
+	    return false;
+	 if (Parser != 0)
+	    Parsers.push_back(Parser);
+      }
+   }
+   if (Parsers.empty() == true)
+      return _error->Error("You must put some 'source' URIs in your sources.list");
+
+   bool Failed = false;
+   std::vector<SrcNameRef> Refs;
+   SavedErrors Pending;
+   SavedErrors Messages;
+   Py_BEGIN_ALLOW_THREADS
+   // This thread scans too; keep its messages apart from those of the scan.
+   SaveErrors(Pending);
+
+   SrcScanJob Job;
+   Job.Parsers = &Parsers;
+   Job.Records.resize(Parsers.size());
+   Job.Refs.resize(Parsers.size());
+   Job.Failed.resize(Parsers.size(),false);
+   Job.Errors.resize(Parsers.size());
+   pthread_mutex_init(&Job.Lock,0);
+   Job.NextFile = 0;
+
+   int Count = Threads;
+   if (Count <= 0)
+      Count = sysconf(_SC_NPROCESSORS_ONLN);
+   if (Count <= 0)
+      Count = 1;
+   if ((size_t)Count > Parsers.size())
+      Count = Parsers.size();
+   // This thread is a worker too, and takes over if no thread could be
+   // started at all.
+   std::vector<pthread_t> Workers(Count);
+   std::vector<bool> Started(Count,false);
+   for (int I = 1; I < Count; I++)
+      if (pthread_create(&Workers[I],0,ScanWorker,&Job) == 0)
+	 Started[I] = true;
+   ScanWorker(&Job);
+   for (int I = 1; I < Count; I++)
+      if (Started[I] == true)
+	 pthread_join(Workers[I],0);
+   pthread_mutex_destroy(&Job.Lock);
+
+   for (unsigned int P = 0; P != Parsers.size(); P++)
+   {
+      Messages.insert(Messages.end(),Job.Errors[P].begin(),Job.Errors[P].end());
+      Failed |= Job.Failed[P];
+      if (Failed == true)
+	 continue;
+
+      // Number the records of this file after those of the previous ones.
+      for (std::vector<SrcNameRef>::iterator I = Job.Refs[P].begin();
+	   I != Job.Refs[P].end(); I++)
+      {
+	 I->Record += New.Index.size();
+	 Refs.push_back(*I);
+      }
+      New.Index.insert(New.Index.end(),Job.Records[P].begin(),
+		       Job.Records[P].end());
+   }
+   if (Failed == false)
+      New.BuildNameTable(Refs);
+   Py_END_ALLOW_THREADS
+
+   // Keep the index of another thread which got here first; the parsers
+   // of the one not used are deleted with New.
+   if (NameIndex.NameTable.empty() == false)
+   {
+      RestoreErrors(Pending);
+      return true;
+   }
+   Pending.insert(Pending.end(),Messages.begin(),Messages.end());
+   RestoreErrors(Pending);
+   if (Failed == false)
+      NameIndex.swap(New);
+   return Failed == false;
+}
+									/*}}}*/
+// SrcNameIndex::BuildNameTable - Build the name lookup tables		/*{{{*/
+// ---------------------------------------------------------------------
+/* Refs holds the names of all records of Index, it is sorted here. */
+void SrcNameIndex::BuildNameTable(std::vector<SrcNameRef> &Refs)
+{
+   // Group the references by name, keeping the records in order.
+   std::sort(Refs.begin(),Refs.end());
+   for (std::vector<SrcNameRef>::iterator I = Refs.begin(); I != Refs.end(); I++)
+   {
+      if (Names.empty() == true || Names.back() != I->Name)
+      {
+	 Names.push_back(I->Name);
+	 MatchStart.push_back(MatchList.size());
+      }
+      if (MatchList.size() == MatchStart.back() || MatchList.back() != I->Record)
+	 MatchList.push_back(I->Record);
+   }
+   MatchStart.push_back(MatchList.size());
+
+   // Keep the load factor below one half, so probe sequences stay short.
+   unsigned long Size = 16;
+   while (Size < 2 * Names.size())
+      Size *= 2;
+   NameTable.resize(Size,0xFFFFFFFF);
+   for (unsigned int N = 0; N != Names.size(); N++)
+   {
+      unsigned long Slot = SrcNameHash(Names[N].c_str()) & (Size - 1);
+      while (NameTable[Slot] != 0xFFFFFFFF)
+	 Slot = (Slot + 1) & (Size - 1);
+      NameTable[Slot] = N;
+   }
+}
+									/*}}}*/
+// SrcNameIndex::FindName - Find the records of a name			/*{{{*/
+// ---------------------------------------------------------------------
+bool SrcNameIndex::FindName(const char *Name,unsigned int *&Begin,
+				   unsigned int *&End)
+{
+   if (NameTable.empty() == true)
+      return false;
+   unsigned long Mask = NameTable.size() - 1;
+   for (unsigned long Slot = SrcNameHash(Name) & Mask;
+	NameTable[Slot] != 0xFFFFFFFF; Slot = (Slot + 1) & Mask)
+   {
+      unsigned int N = NameTable[Slot];
+      if (Names[N] != Name)
+	 continue;
+      Begin = &MatchList[0] + MatchStart[N];
+      End = &MatchList[0] + MatchStart[N + 1];
+      return true;
+   }
+   return false;
+}
+									/*}}}*/
+
 // PkgSrcRecords Class							/*{{{*/
 // ---------------------------------------------------------------------
 
-static char *doc_PkgSrcRecordsLookup = "xxx";
+static char *doc_PkgSrcRecordsLookup =
+    "lookup(name: str) -> int\n\n"
+    "Look up the next record of the source package name, or of the source\n"
+    "package building the binary package name, after the current record.\n"
+    "Return 1 if a record was found, or None and restart if there are no\n"
+    "more records.";
 static PyObject *PkgSrcRecordsLookup(PyObject *Self,PyObject *Args)
 {
    PkgSrcRecordsStruct &Struct = GetCpp<PkgSrcRecordsStruct>(Self);
@@ -43,6 +358,31 @@ static PyObject *PkgSrcRecordsLookup(PyObject *Self,PyObject *Args)
    if (PyArg_ParseTuple(Args,"s",&Name) == 0)
       return 0;
 
+   if (Struct.Indexed == true)
+   {
+      // The first match after the current record, like Find() would return.
+      unsigned int *Begin, *End;
+      if (Struct.NameIndex.FindName(Name,Begin,End) == true)
+      {
+	 unsigned int *Match = std::lower_bound(Begin,End,Struct.Next);
+	 if (Match != End)
+	 {
+	    SrcRecordRef &Record = Struct.NameIndex.Index[*Match];
+	    pkgSrcRecords::Parser *Parser = Struct.NameIndex.Parsers[Record.Parser];
+	    if (Parser->Jump(Record.Offset) == true)
+	    {
+	       Struct.Last = Parser;
+	       Struct.Next = *Match + 1;
+	       return Py_BuildValue("i", 1);
+	    }
+	 }
+      }
+      Struct.Last = 0;
+      Struct.Next = 0;
+      Py_INCREF(Py_None);
+      return HandleErrors(Py_None);
+   }
+
    Struct.Last = Struct.Records->Find(Name, false);
    if (Struct.Last == 0) {
       Struct.Records->Restart();
@@ -53,6 +393,47 @@ static PyObject *PkgSrcRecordsLookup(PyObject *Self,PyObject *Args)
    return Py_BuildValue("i", 1);
 }
 
+static char *doc_PkgSrcRecordsLookupAll =
+    "lookup_all(name: str) -> list\n\n"
+    "Return all records matching name, in the order of lookup(), without\n"
+    "changing the current record.";
+static PyObject *PkgSrcRecordsLookupAll(PyObject *Self,PyObject *Args)
+{
+   PkgSrcRecordsStruct &Struct = GetCpp<PkgSrcRecordsStruct>(Self);
+
+   char *Name = 0;
+   if (PyArg_ParseTuple(Args,"s",&Name) == 0)
+      return 0;
+
+   // Objects not created with index=True build the index on first use.
+   if (Struct.NameIndex.NameTable.empty() == true && Struct.BuildIndex() == false)
+      return HandleErrors();
+
+   PyObject *List = PyList_New(0);
+   unsigned int *Begin, *End;
+   if (Struct.NameIndex.FindName(Name,Begin,End) == true)
+   {
+      for (unsigned int *I = Begin; I != End; I++)
+      {
+	 SrcRecordRef &Record = Struct.NameIndex.Index[*I];
+	 pkgSrcRecords::Parser *Parser = Struct.NameIndex.Parsers[Record.Parser];
+	 if (Parser->Jump(Record.Offset) == false)
+	    break;
+	 PyObject *Str = CppPyString(Parser->AsStr());
+	 PyList_Append(List,Str);
+	 Py_DECREF(Str);
+      }
+   }
+
+   // The parser of the current record may have moved, go back to it.
+   if (Struct.Indexed == true && Struct.Last != 0)
+   {
+      SrcRecordRef &Record = Struct.NameIndex.Index[Struct.Next - 1];
+      Struct.NameIndex.Parsers[Record.Parser]->Jump(Record.Offset);
+   }
+   return HandleErrors(List);
+}
+
 static char *doc_PkgSrcRecordsRestart = "Start Lookup from the beginning";
 static PyObject *PkgSrcRecordsRestart(PyObject *Self,PyObject *Args)
 {
@@ -61,7 +442,13 @@ static PyObject *PkgSrcRecordsRestart(PyObject *Self,PyObject *Args)
    if (PyArg_ParseTuple(Args,"") == 0)
       return 0;
 
-   Struct.Records->Restart();
+   if (Struct.Indexed == true)
+   {
+      Struct.Last = 0;
+      Struct.Next = 0;
+   }
+   else
+      Struct.Records->Restart();
 
    Py_INCREF(Py_None);
    return HandleErrors(Py_None);
@@ -70,6 +457,7 @@ static PyObject *PkgSrcRecordsRestart(PyObject *Self,PyObject *Args)
 static PyMethodDef PkgSrcRecordsMethods[] =
 {
    {"lookup",PkgSrcRecordsLookup,METH_VARARGS,doc_PkgSrcRecordsLookup},
+   {"lookup_all",PkgSrcRecordsLookupAll,METH_VARARGS,doc_PkgSrcRecordsLookupAll},
    {"restart",PkgSrcRecordsRestart,METH_VARARGS,doc_PkgSrcRecordsRestart},
    {}
 };
@@ -236,11 +624,23 @@ static PyGetSetDef PkgSrcRecordsGetSet[] = {
 };
 
 static PyObject *PkgSrcRecordsNew(PyTypeObject *type,PyObject *args,PyObject *kwds) {
-   char *kwlist[] = {0};
-   if (PyArg_ParseTupleAndKeywords(args,kwds,"",kwlist) == 0)
+   char Indexed = 0;
+   int Threads = 1;
+   char *kwlist[] = {"index","threads",0};
+   if (PyArg_ParseTupleAndKeywords(args,kwds,"|bi",kwlist,&Indexed,&Threads) == 0)
       return 0;
+   if (Threads < 0)
+   {
+      PyErr_SetString(PyExc_ValueError,"threads must not be negative");
+      return 0;
+   }
 
-   return HandleErrors(CppPyObject_NEW<PkgSrcRecordsStruct>(NULL, type));
+   CppPyObject<PkgSrcRecordsStruct> *New;
+   New = CppPyObject_NEW<PkgSrcRecordsStruct>(NULL, type, Indexed == true);
+   New->Object.Threads = Threads;
+   if (Indexed == true && _error->PendingError() == false)
+      New->Object.BuildIndex();
+   return HandleErrors(New);
 }
 
 PyTypeObject PySourceRecords_Type =
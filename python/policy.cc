@@ -21,6 +21,7 @@
 #include <Python.h>
 #include "apt_pkgmodule.h"
 #include "generic.h"
+#include "cache.h"
 #include <apt-pkg/policy.h>
 
 static PyObject *policy_new(PyTypeObject *type,PyObject *Args,
@@ -61,8 +62,7 @@ PyObject *policy_get_candidate_ver(PyObject *self, PyObject *arg) {
         pkgPolicy *policy = GetCpp<pkgPolicy *>(self);
         pkgCache::PkgIterator pkg = GetCpp<pkgCache::PkgIterator>(arg);
         pkgCache::VerIterator ver = policy->GetCandidateVer(pkg);
-        return CppPyObject_NEW<pkgCache::VerIterator>(arg,&PyVersion_Type,
-                                                           ver);
+        return GetVersionObject(arg,ver);
     } else {
         PyErr_SetString(PyExc_TypeError,"Argument must be of Package().");
         return 0;
@@ -81,7 +81,7 @@ static PyObject *policy_get_match(PyObject *self, PyObject *arg) {
     pkgPolicy *policy = GetCpp<pkgPolicy *>(self);
     pkgCache::PkgIterator pkg = GetCpp<pkgCache::PkgIterator>(arg);
     pkgCache::VerIterator ver = policy->GetMatch(pkg);
-    return CppPyObject_NEW<pkgCache::VerIterator>(arg,&PyVersion_Type,ver);
+    return GetVersionObject(arg,ver);
 }
 
 static char *policy_read_pinfile_doc = "read_pinfile(filename: str) -> bool\n\n"
@@ -28,6 +28,7 @@
 #include <apt-pkg/tagfile.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
 #include <Python.h>
 
@@ -37,6 +38,10 @@ using namespace std;
 struct TagSecData : public CppPyObject<pkgTagSection>
 {
    char *Data;
+#ifdef HAVE_NEWBUFFER
+   // ..unless it is scanned in place from the buffer of another object.
+   Py_buffer *View;
+#endif
 };
 
 // The owner of the TagFile is a Python file object.
@@ -68,6 +73,13 @@ void TagSecFree(PyObject *Obj)
 {
    TagSecData *Self = (TagSecData *)Obj;
    delete [] Self->Data;
+#ifdef HAVE_NEWBUFFER
+   if (Self->View != 0)
+   {
+      PyBuffer_Release(Self->View);
+      delete Self->View;
+   }
+#endif
    CppDealloc<pkgTagSection>(Obj);
 }
 									/*}}}*/
@@ -321,20 +333,66 @@ static PyObject *TagFileJump(PyObject *Self,PyObject *Args)
 // ParseSection - Parse a single section from a tag file		/*{{{*/
 // ---------------------------------------------------------------------
 static PyObject *TagSecNew(PyTypeObject *type,PyObject *Args,PyObject *kwds) {
-   char *Data;
+   PyObject *Text;
    char *kwlist[] = {"text", 0};
-   if (PyArg_ParseTupleAndKeywords(Args,kwds,"s",kwlist,&Data) == 0)
+   if (PyArg_ParseTupleAndKeywords(Args,kwds,"O",kwlist,&Text) == 0)
       return 0;
 
    // Create the object..
    TagSecData *New = (TagSecData*)type->tp_alloc(type, 0);
    new (&New->Object) pkgTagSection();
-   New->Data = new char[strlen(Data)+2];
-   snprintf(New->Data,strlen(Data)+2,"%s\n",Data);
 
-   if (New->Object.Scan(New->Data,strlen(New->Data)) == false)
+   const char *Data;
+   unsigned long Length;
+#ifdef HAVE_NEWBUFFER
+   if (PyString_Check(Text) == 0 && PyUnicode_Check(Text) == 0 &&
+       PyObject_CheckBuffer(Text) == 1)
+   {
+      New->View = new Py_buffer;
+      if (PyObject_GetBuffer(Text,New->View,PyBUF_SIMPLE) == -1)
+      {
+	 delete New->View;
+	 New->View = 0;
+	 Py_DECREF((PyObject *)New);
+	 return 0;
+      }
+      Data = (const char *)New->View->buf;
+      Length = New->View->len;
+
+      /* A section ends with a blank line. If the buffer has one, like the
+         record_view of PackageRecords, the section can be scanned in place;
+         otherwise it has to be copied to append it. */
+      if (Length < 2 || Data[Length - 2] != '\n' || Data[Length - 1] != '\n')
+      {
+	 New->Data = new char[Length + 2];
+	 memcpy(New->Data,Data,Length);
+	 New->Data[Length] = '\n';
+	 New->Data[Length + 1] = 0;
+	 Data = New->Data;
+	 Length++;
+	 PyBuffer_Release(New->View);
+	 delete New->View;
+	 New->View = 0;
+      }
+   }
+   else
+#endif
+   {
+      char *Str;
+      if (PyArg_Parse(Text,"s;text must be a string or a buffer",&Str) == 0)
+      {
+	 Py_DECREF((PyObject *)New);
+	 return 0;
+      }
+      New->Data = new char[strlen(Str)+2];
+      snprintf(New->Data,strlen(Str)+2,"%s\n",Str);
+      Data = New->Data;
+      Length = strlen(New->Data);
+   }
+
+   if (New->Object.Scan(Data,Length) == false)
    {
-      cerr << New->Data << endl;
+      cerr << string(Data,Length) << endl;
       Py_DECREF((PyObject *)New);
       PyErr_SetString(PyExc_ValueError,"Unable to parse section data");
       return 0;
@@ -29,10 +29,10 @@ if sys.version_info[0] == 3:
 
 # The apt_pkg module.
 files = ['apt_pkgmodule.cc', 'acquire.cc', 'cache.cc', 'cdrom.cc',
-         'configuration.cc', 'depcache.cc', 'generic.cc', 'hashes.cc',
-         'hashstring.cc', 'indexfile.cc', 'indexrecords.cc', 'metaindex.cc',
-         'pkgmanager.cc', 'pkgrecords.cc', 'pkgsrcrecords.cc', 'policy.cc',
-         'progress.cc', 'sourcelist.cc', 'string.cc', 'tag.cc',
+         'columns.cc', 'configuration.cc', 'depcache.cc', 'generic.cc',
+         'hashes.cc', 'hashstring.cc', 'indexfile.cc', 'indexrecords.cc',
+         'metaindex.cc', 'pkgmanager.cc', 'pkgrecords.cc', 'pkgsrcrecords.cc',
+         'policy.cc', 'progress.cc', 'sourcelist.cc', 'string.cc', 'tag.cc',
          'lock.cc', 'acquire-item.cc', 'python-apt-helpers.cc']
 files = sorted(['python/' + fname for fname in files], key=lambda s: s[:-3])
 apt_pkg = Extension("apt_pkg", files, libraries=["apt-pkg"])
@@ -0,0 +1,47 @@
+#!/usr/bin/python
+#
+# Benchmark for PackageRecords(cache, mmap=True)
+# compares the time to read the records of all candidates with and
+# without mapping the index files.
+#
+
+import sys
+import time
+
+import apt_pkg
+
+
+def run(cache, depcache, mmap):
+    start = time.time()
+    records = apt_pkg.PackageRecords(cache, mmap=mmap)
+    count = 0
+    for pkg in cache.packages:
+        version = depcache.get_candidate_ver(pkg)
+        if not version:
+            continue
+        if records.lookup(version.file_list[0]):
+            records.source_pkg
+            records.short_desc
+            records.long_desc
+            count += 1
+    return count, time.time() - start
+
+
+def main():
+    apt_pkg.init()
+    cache = apt_pkg.Cache()
+    depcache = apt_pkg.DepCache(cache)
+    rounds = 3
+    for mmap in (False, True):
+        best = None
+        for i in range(rounds):
+            count, elapsed = run(cache, depcache, mmap)
+            if best is None or elapsed < best:
+                best = elapsed
+        print("mmap=%s: %i records in %.3fs (best of %i)" % (
+            mmap, count, best, rounds))
+
+
+if __name__ == "__main__":
+    main()
+    sys.exit(0)
@@ -0,0 +1,201 @@
+#!/usr/bin/python
+#
+# Copyright (C) 2010 Julian Andres Klode <jak@debian.org>
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.
+"""Unit tests for apt_pkg.Cache and the objects it creates."""
+import unittest
+
+import apt_pkg
+import apt.progress.base
+
+
+class TestPkgCache(unittest.TestCase):
+    """test apt_pkg.Cache"""
+
+    def setUp(self):
+        self.cache = apt_pkg.Cache(apt.progress.base.OpProgress())
+
+    def test_package_list(self):
+        """cache: random access, slicing and iteration of cache.packages"""
+        packages = self.cache.packages
+        self.assertEqual(len(packages), self.cache.package_count)
+        # Packages are ordered by ID, regardless of the access pattern.
+        for i in reversed(range(len(packages))):
+            self.assertEqual(packages[i].id, i)
+        self.assertEqual(packages[-1].id, len(packages) - 1)
+        self.assertRaises(IndexError, packages.__getitem__, len(packages))
+        self.assertEqual([pkg.id for pkg in packages[10:0:-2]],
+                         list(range(10, 0, -2)))
+        self.assertEqual([pkg.id for pkg in packages],
+                         list(range(len(packages))))
+        # Iterators follow the iterator protocol and keep their position.
+        it = iter(packages)
+        self.assertTrue(iter(it) is it)
+        self.assertEqual(next(it).id, 0)
+        self.assertEqual([pkg.id for pkg in it],
+                         list(range(1, len(packages))))
+
+    def test_interned_names(self):
+        """cache: package names and version strings are shared objects"""
+        pkg = self.cache.packages[0]
+        self.assertTrue(pkg.name is self.cache.packages[0].name)
+        # Each access creates new wrappers, which share the strings.
+        other = self.cache.packages[0]
+        self.assertFalse(other is pkg)
+        for ver, other_ver in zip(pkg.version_list, other.version_list):
+            self.assertFalse(ver is other_ver)
+            self.assertTrue(ver.ver_str is other_ver.ver_str)
+
+    def test_unique_objects(self):
+        """cache: unique_objects returns the same wrapper for a package"""
+        cache = apt_pkg.Cache(apt.progress.base.OpProgress(),
+                              unique_objects=True)
+        pkg = cache.packages[0]
+        self.assertTrue(pkg is cache.packages[0])
+        for ver in pkg.version_list:
+            self.assertTrue(ver.parent_pkg is pkg)
+            self.assertTrue(ver in pkg.version_list)
+        del pkg
+        # A new object is created once the old one is gone.
+        self.assertEqual(cache.packages[0].id, 0)
+        self.assertFalse(self.cache.packages[0] is self.cache.packages[0])
+
+    def test_closure(self):
+        """cache: dependency closures"""
+        for pkg in self.cache.packages:
+            if pkg.version_list and pkg.version_list[0].depends_list:
+                break
+        else:
+            self.skipTest("no package with dependencies in the cache")
+        closure = self.cache.closure([pkg])
+        self.assertEqual(closure[0], pkg.id)
+        self.assertEqual(len(set(closure)), len(closure))
+        depends = pkg.version_list[0].depends_list.get("Depends", [])
+        for target in [dep.target_pkg for group in depends for dep in group]:
+            self.assertTrue(target.id in closure)
+        self.assertEqual(list(self.cache.closure([pkg.id], max_depth=0)),
+                         [pkg.id])
+        # Everything reached is reverse-reachable from the start.
+        for pkg_id in list(self.cache.closure([pkg], max_depth=1))[1:]:
+            self.assertTrue(pkg.id in self.cache.closure(
+                [pkg_id], reverse=True, release_gil=True))
+        self.assertRaises(ValueError, self.cache.closure, [pkg], ["Foo"])
+
+    def test_depends_views(self):
+        """cache: lazy depends_view and iter_depends match depends_list"""
+        for pkg in list(self.cache.packages)[:100]:
+            for ver in pkg.version_list:
+                depends = ver.depends_list
+                view = ver.depends_view
+                self.assertEqual(sorted(view.keys()), sorted(depends.keys()))
+                self.assertEqual(len(view), len(depends))
+                for type_ in depends:
+                    self.assertTrue(type_ in view)
+                    expected = [[dep.id for dep in group]
+                                for group in depends[type_]]
+                    self.assertEqual([[dep.id for dep in group]
+                                      for group in view[type_]], expected)
+                    self.assertEqual([[dep.id for dep in group]
+                                      for group in ver.iter_depends(type_)],
+                                     expected)
+                self.assertEqual(view.get("Foo"), None)
+                self.assertEqual(sum(len(v) for v in depends.values()),
+                                 len(list(ver.iter_depends())))
+
+    def test_lookup_many(self):
+        """cache: batch lookup of package names"""
+        names = [pkg.name for pkg in list(self.cache.packages)[:50]]
+        names.append("no-such-package-at-all")
+        for build_index in (False, True):
+            if build_index:
+                self.cache.build_name_index()
+            pkgs = self.cache.lookup_many(names)
+            ids = self.cache.lookup_many(names, ids=True)
+            self.assertEqual(pkgs[-1], None)
+            self.assertEqual(ids[len(names) - 1], 0xFFFFFFFF)
+            for i, name in enumerate(names[:-1]):
+                self.assertEqual(pkgs[i].name, name)
+                self.assertEqual(ids[i], self.cache[name].id)
+                self.assertTrue(name in self.cache)
+            self.assertFalse(names[-1] in self.cache)
+
+    def test_select(self):
+        """cache: parallel selection of packages and versions"""
+        expected = [pkg.id for pkg in self.cache.packages
+                    if pkg.name.startswith("lib")]
+        for threads in (1, 4):
+            self.assertEqual(list(self.cache.select(
+                [("name", "fnmatch", "lib*")], threads=threads)), expected)
+            self.assertEqual(list(self.cache.select(
+                [("name", "regex", "^lib")], threads=threads)), expected)
+        versions = self.cache.select([("arch", "==", "all")], versions=True)
+        self.assertEqual(len(versions),
+                         len([ver for pkg in self.cache.packages
+                              for ver in pkg.version_list
+                              if ver.arch == "all"]))
+        self.assertRaises(ValueError, self.cache.select,
+                          [("foo", "==", "bar")])
+        self.assertRaises(ValueError, self.cache.select,
+                          [("name", "<", "bar")])
+
+    def test_rebuild_stats(self):
+        """cache: statistics about rebuilding the cache"""
+        self.assertEqual(self.cache.rebuild_stats, None)
+        cache = apt_pkg.Cache(apt.progress.base.OpProgress(),
+                              rebuild_stats=True)
+        stats = cache.rebuild_stats
+        self.assertTrue(stats["rebuild"] in ("none", "status", "full"))
+        self.assertEqual(stats["rebuild"] == "none", stats["pkgcache_valid"])
+        self.assertTrue(stats["index_files"] >= len(stats["changed_files"]))
+        self.assertTrue(stats["open_time"] >= 0)
+        self.assertRaises(ValueError, apt_pkg.Cache, readonly_mmap=True,
+                          rebuild_stats=True)
+
+    def test_readonly_mmap(self):
+        """cache: mapping the binary cache read-only"""
+        try:
+            readonly = apt_pkg.Cache(readonly_mmap=True)
+        except SystemError:
+            # The cache on disk may be missing or out of date (e.g. if we
+            # are not allowed to write it).
+            self.skipTest("no up-to-date binary cache on disk")
+        self.assertEqual(readonly.package_count, self.cache.package_count)
+        self.assertEqual([pkg.name for pkg in readonly.packages],
+                         [pkg.name for pkg in self.cache.packages])
+        depcache = apt_pkg.DepCache(readonly)
+        self.assertEqual(depcache.del_count, 0)
+
+    def test_export_columns(self):
+        """cache: columnar export of package and version fields"""
+        cols = self.cache.export_columns(["id", "name", "current_ver"])
+        self.assertEqual(len(cols["id"]), self.cache.package_count)
+        self.assertEqual(len(cols["name"]), self.cache.package_count + 1)
+        strings = cols["strings"]
+        names = cols["name"]
+        for pkg in self.cache.packages:
+            self.assertEqual(cols["id"][pkg.id], pkg.id)
+            name = strings[names[pkg.id]:names[pkg.id + 1]].decode("utf-8")
+            self.assertEqual(name, pkg.name)
+            if pkg.current_ver:
+                self.assertEqual(cols["current_ver"][pkg.id],
+                                 pkg.current_ver.id)
+        cols = self.cache.export_columns(["name", "section"])
+        strings = cols["strings"]
+        names, sections = cols["name"], cols["section"]
+        for pkg in self.cache.packages:
+            name = strings[names[pkg.id]:names[pkg.id + 1]].decode("utf-8")
+            self.assertEqual(name, pkg.name)
+            section = strings[sections[pkg.id]:sections[pkg.id + 1]]
+            self.assertEqual(section.decode("utf-8"), pkg.section or "")
+        self.assertEqual(sections[self.cache.package_count], len(strings))
+        sizes = self.cache.export_columns(["size"], versions=True)["size"]
+        self.assertEqual(len(sizes), self.cache.version_count)
+        self.assertEqual(sizes.typecode, "Q")
+        self.assertRaises(ValueError, self.cache.export_columns,
+                          ["nonexisting"])
+
+if __name__ == "__main__":
+    unittest.main()
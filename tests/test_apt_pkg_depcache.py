@@ -0,0 +1,183 @@
+#!/usr/bin/python
+#
+# Copyright (C) 2010 Julian Andres Klode <jak@debian.org>
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.
+"""Unit tests for apt_pkg.DepCache and apt_pkg.ProblemResolver."""
+import unittest
+
+import apt_pkg
+import apt.progress.base
+
+
+class TestPkgDepCache(unittest.TestCase):
+    """test apt_pkg.DepCache"""
+
+    def setUp(self):
+        self.cache = apt_pkg.Cache(apt.progress.base.OpProgress())
+        self.depcache = apt_pkg.DepCache(self.cache)
+
+    def test_depcache_snapshot(self):
+        """depcache: restoring a snapshot of the depcache marks"""
+        counts = (self.depcache.inst_count, self.depcache.del_count,
+                  self.depcache.keep_count, self.depcache.broken_count,
+                  self.depcache.usr_size, self.depcache.deb_size)
+        snap = self.depcache.snapshot()
+        self.assertTrue(snap.size > 0)
+        for pkg in self.cache.packages:
+            if pkg.current_ver:
+                self.depcache.mark_delete(pkg)
+                break
+        self.depcache.restore(snap)
+        self.assertEqual((self.depcache.inst_count, self.depcache.del_count,
+                          self.depcache.keep_count, self.depcache.broken_count,
+                          self.depcache.usr_size, self.depcache.deb_size),
+                         counts)
+        for pkg in self.cache.packages:
+            self.assertFalse(self.depcache.marked_delete(pkg))
+        other = apt_pkg.Cache(apt.progress.base.OpProgress())
+        self.assertRaises(ValueError, apt_pkg.DepCache(other).restore, snap)
+
+    def test_depcache_mark_many(self):
+        """depcache: marking many packages at once"""
+        installed = [pkg for pkg in self.cache.packages if pkg.current_ver][:5]
+        self.depcache.mark_delete_many([pkg.id for pkg in installed])
+        for pkg in installed:
+            self.assertTrue(self.depcache.marked_delete(pkg))
+        self.depcache.mark_keep_many(installed)
+        for pkg in installed:
+            self.assertFalse(self.depcache.marked_delete(pkg))
+        self.assertEqual(self.depcache.del_count, 0)
+        self.assertRaises(IndexError, self.depcache.mark_install_many,
+                          [self.cache.package_count])
+        self.assertRaises(TypeError, self.depcache.mark_install_many, ["apt"])
+
+    def test_depcache_states(self):
+        """depcache: state flags of all packages"""
+        installed = [pkg for pkg in self.cache.packages if pkg.current_ver][:3]
+        self.depcache.mark_delete_many(installed)
+        states = self.depcache.states()
+        self.assertEqual(len(states), self.cache.package_count)
+        for pkg in self.cache.packages:
+            state = states[pkg.id]
+            self.assertEqual(bool(state & self.depcache.STATE_DELETE),
+                             bool(self.depcache.marked_delete(pkg)))
+            self.assertEqual(bool(state & self.depcache.STATE_INSTALL),
+                             bool(self.depcache.marked_install(pkg)))
+            self.assertEqual(bool(state & self.depcache.STATE_KEEP),
+                             bool(self.depcache.marked_keep(pkg)))
+        self.assertEqual(sorted(self.depcache.changed_ids()),
+                         sorted(pkg.id for pkg in installed))
+
+    def test_solver_stats(self):
+        """depcache: statistics of solver runs"""
+        self.assertEqual(self.depcache.stats, None)
+        self.depcache.fix_broken()
+        self.assertEqual(self.depcache.stats, None)
+        self.depcache.collect_stats = True
+        self.depcache.fix_broken()
+        stats = self.depcache.stats
+        self.assertEqual(sorted(stats["phases"]),
+                         ["fix_broken", "minimize_upgrade"])
+        self.assertTrue(stats["time"] >= 0)
+        self.assertEqual(stats["broken_after"], self.depcache.broken_count)
+        resolver = apt_pkg.ProblemResolver(self.depcache)
+        resolver.collect_stats = True
+        resolver.resolve_by_keep()
+        self.assertEqual(list(resolver.stats["phases"]), ["resolve_by_keep"])
+        self.assertEqual(resolver.stats["protect_count"], 0)
+        # The protect() calls are counted for the next run only.
+        resolver.protect(self.cache.packages[0])
+        resolver.resolve_by_keep()
+        self.assertEqual(resolver.stats["protect_count"], 1)
+        resolver.resolve_by_keep()
+        self.assertEqual(resolver.stats["protect_count"], 0)
+
+    def test_depcache_clone(self):
+        """depcache: cloning the depcache and evaluating installs"""
+        clone = self.depcache.clone()
+        installed = [pkg for pkg in self.cache.packages if pkg.current_ver][:3]
+        clone.mark_delete_many(installed)
+        self.assertEqual(clone.del_count, len(installed))
+        self.assertEqual(self.depcache.del_count, 0)
+
+        candidates = [pkg for pkg in self.cache.packages
+                      if pkg.version_list and not pkg.current_ver][:4]
+        results = apt_pkg.evaluate_installs(self.depcache, candidates,
+                                            threads=2)
+        self.assertEqual(len(results), len(candidates))
+        for pkg, changes in zip(candidates, results):
+            clone = self.depcache.clone()
+            clone.mark_install(pkg)
+            self.assertEqual(sorted(changes), sorted(clone.changed_ids()))
+        self.assertEqual(self.depcache.inst_count, 0)
+
+    def test_garbage_ids(self):
+        """depcache: bulk query of garbage packages"""
+        garbage = list(self.depcache.garbage_ids())
+        self.assertEqual(garbage, sorted(garbage))
+        expected = [pkg.id for pkg in self.cache.packages
+                    if pkg.current_ver and self.depcache.is_garbage(pkg)]
+        self.assertEqual(garbage, sorted(expected))
+
+    def test_candidate_table(self):
+        """depcache: candidate versions of all packages"""
+        table = self.depcache.candidate_table()
+        self.assertEqual(len(table), self.cache.package_count)
+        for pkg in self.cache.packages:
+            cand = self.depcache.get_candidate_ver(pkg)
+            if cand is None:
+                self.assertEqual(table[pkg.id], 0xFFFFFFFF)
+            else:
+                self.assertEqual(table[pkg.id], cand.id)
+        for pkg in self.cache.packages:
+            if len(pkg.version_list) > 1:
+                other = pkg.version_list[-1]
+                if other.id != table[pkg.id]:
+                    self.depcache.set_candidate_ver(pkg, other)
+                    self.assertEqual(self.depcache.candidate_table()[pkg.id],
+                                     other.id)
+                    break
+
+    def test_size_deltas(self):
+        """depcache: per-package sizes of the changes"""
+        installed = [pkg for pkg in self.cache.packages if pkg.current_ver][:3]
+        self.depcache.mark_delete_many(installed)
+        ids, download, installed_size = self.depcache.size_deltas()
+        self.assertEqual(len(ids), len(download))
+        self.assertEqual(len(ids), len(installed_size))
+        self.assertEqual(list(ids), sorted(ids))
+        self.assertEqual(sum(download), self.depcache.deb_size)
+        self.assertEqual(sum(installed_size), self.depcache.usr_size)
+        for pkg in installed:
+            self.assertTrue(pkg.id in list(ids))
+
+    def test_depcache_undo(self):
+        """depcache: undoing marks recorded in the journal"""
+        self.assertRaises(IndexError, self.depcache.undo)
+        self.depcache.keep_journal = True
+        installed = [pkg for pkg in self.cache.packages if pkg.current_ver][:3]
+        states = list(self.depcache.states())
+        self.depcache.mark_delete(installed[0])
+        self.depcache.mark_delete_many(installed[1:])
+        self.assertEqual(self.depcache.journal_length, 2)
+        self.assertEqual(self.depcache.del_count, len(installed))
+        self.depcache.undo()
+        self.assertEqual(self.depcache.del_count, 1)
+        self.assertTrue(self.depcache.marked_delete(installed[0]))
+        self.depcache.undo()
+        self.assertEqual(self.depcache.journal_length, 0)
+        self.assertEqual(self.depcache.del_count, 0)
+        self.assertEqual(list(self.depcache.states()), states)
+        # Solver runs are recorded as well.
+        self.depcache.mark_delete(installed[0])
+        apt_pkg.ProblemResolver(self.depcache).resolve()
+        self.depcache.fix_broken()
+        self.assertEqual(self.depcache.journal_length, 3)
+        self.depcache.undo(3)
+        self.assertEqual(list(self.depcache.states()), states)
+
+if __name__ == "__main__":
+    unittest.main()
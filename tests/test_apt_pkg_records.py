@@ -0,0 +1,203 @@
+#!/usr/bin/python
+#
+# Copyright (C) 2010 Julian Andres Klode <jak@debian.org>
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.
+"""Unit tests for apt_pkg.PackageRecords and apt_pkg.SourceRecords."""
+import os
+import shutil
+import tempfile
+import threading
+import unittest
+
+import apt_pkg
+import apt.progress.base
+
+
+class TestPkgRecords(unittest.TestCase):
+    """test the package and source records"""
+
+    def setUp(self):
+        self.cache = apt_pkg.Cache(apt.progress.base.OpProgress())
+
+    def test_records_lookup_many(self):
+        """records: reading many package records at once"""
+        records = apt_pkg.PackageRecords(self.cache)
+        verfiles = []
+        for pkg in self.cache.packages:
+            for ver in pkg.version_list:
+                if ver.file_list:
+                    verfiles.append(ver.file_list[0])
+            if len(verfiles) >= 50:
+                break
+        fields = ["name", "maintainer", "filename"]
+        values = records.lookup_many(verfiles, fields)
+        self.assertEqual(len(values), len(verfiles))
+        for verfile, value in zip(verfiles, values):
+            records.lookup(verfile)
+            self.assertEqual(value, (records.name, records.maintainer,
+                                     records.filename))
+        columns = records.lookup_many(verfiles, fields, columnar=True)
+        self.assertEqual(columns["name"], [value[0] for value in values])
+        self.assertRaises(ValueError, records.lookup_many, verfiles, ["x"])
+
+    def test_records_record_view(self):
+        """records: viewing package records without copying"""
+        records = apt_pkg.PackageRecords(self.cache)
+        verfiles = [ver.file_list[0] for pkg in self.cache.packages
+                    for ver in pkg.version_list if ver.file_list][:10]
+        for verfile in verfiles:
+            records.lookup(verfile)
+            view = records.record_view
+            self.assertTrue(view.readonly)
+            record = view.tobytes().decode("utf-8")
+            self.assertEqual(record.rstrip("\n"), records.record.rstrip("\n"))
+            section = apt_pkg.TagSection(view)
+            self.assertEqual(section["Package"], records.name)
+            del section, view
+
+    def test_records_mmap(self):
+        """records: reading package records from mapped index files"""
+        records = apt_pkg.PackageRecords(self.cache)
+        mapped = apt_pkg.PackageRecords(self.cache, mmap=True)
+        verfiles = [ver.file_list[0] for pkg in self.cache.packages
+                    for ver in pkg.version_list if ver.file_list][:50]
+        fields = ["name", "source_pkg", "source_ver", "long_desc",
+                  "sha256_hash", "record"]
+        for verfile in reversed(verfiles):
+            records.lookup(verfile)
+            mapped.lookup(verfile)
+            for field in fields:
+                self.assertEqual(getattr(mapped, field),
+                                 getattr(records, field))
+        self.assertEqual(mapped.lookup_many(verfiles, fields),
+                         records.lookup_many(verfiles, fields))
+
+    def test_source_records_index(self):
+        """records: indexed lookups of source records"""
+        try:
+            src = apt_pkg.SourceRecords()
+            indexed = apt_pkg.SourceRecords(index=True)
+        except SystemError:
+            self.skipTest("no deb-src lines in sources.list")
+        for pkg in list(self.cache.packages)[:5]:
+            versions = []
+            while src.lookup(pkg.name):
+                versions.append((src.package, src.version))
+            indexed_versions = []
+            while indexed.lookup(pkg.name):
+                indexed_versions.append((indexed.package, indexed.version))
+            self.assertEqual(indexed_versions, versions)
+            records = indexed.lookup_all(pkg.name)
+            self.assertEqual(len(records), len(versions))
+            for record, (package, version) in zip(records, versions):
+                section = apt_pkg.TagSection(record)
+                self.assertEqual(section["Version"], version)
+
+    def test_source_records_interleaved(self):
+        """records: indexed lookups of different names share the position"""
+        try:
+            src = apt_pkg.SourceRecords()
+            indexed = apt_pkg.SourceRecords(index=True)
+        except SystemError:
+            self.skipTest("no deb-src lines in sources.list")
+        names = [pkg.name for pkg in list(self.cache.packages)[:6]]
+        for first, second in zip(names[::2], names[1::2]):
+            for name in [first, second, first, first, second, second]:
+                found = src.lookup(name)
+                self.assertEqual(indexed.lookup(name), found)
+                if found:
+                    self.assertEqual((indexed.package, indexed.version),
+                                     (src.package, src.version))
+
+    def test_source_records_threads(self):
+        """records: building the source records index on several threads"""
+        self.assertRaises(ValueError, apt_pkg.SourceRecords, index=True,
+                          threads=-1)
+        try:
+            serial = apt_pkg.SourceRecords(index=True)
+            parallel = apt_pkg.SourceRecords(index=True, threads=4)
+        except SystemError:
+            self.skipTest("no deb-src lines in sources.list")
+        for pkg in list(self.cache.packages)[:50]:
+            self.assertEqual(parallel.lookup_all(pkg.name),
+                             serial.lookup_all(pkg.name))
+        # Two threads building the index of the same object on first use.
+        name = self.cache.packages[0].name
+        src = apt_pkg.SourceRecords(threads=2)
+        results = []
+        threads = [threading.Thread(
+            target=lambda: results.append(src.lookup_all(name)))
+            for i in range(2)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(results, [serial.lookup_all(name)] * 2)
+
+
+class TestPkgRecordsData(unittest.TestCase):
+    """test the package records of the index in data/records"""
+
+    def setUp(self):
+        data = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            "data", "records")
+        self.tmpdir = tempfile.mkdtemp()
+        options = {"APT::Architecture": "i386",
+                   "APT::Acquire::Translation": "de",
+                   "Dir::Etc::sourcelist": os.path.join(data, "sources.list"),
+                   "Dir::Etc::sourceparts": "/xxx",
+                   "Dir::State::lists": os.path.join(data, "lists"),
+                   "Dir::State::status": os.path.join(data, "status"),
+                   "Dir::Cache::pkgcache": os.path.join(self.tmpdir,
+                                                        "pkgcache.bin"),
+                   "Dir::Cache::srcpkgcache": os.path.join(self.tmpdir,
+                                                           "srcpkgcache.bin")}
+        self.saved = {}
+        for key, value in options.items():
+            if apt_pkg.config.exists(key):
+                self.saved[key] = apt_pkg.config.find(key)
+            else:
+                self.saved[key] = None
+            apt_pkg.config.set(key, value)
+        self.cache = apt_pkg.Cache(apt.progress.base.OpProgress())
+
+    def tearDown(self):
+        for key, value in self.saved.items():
+            if value is None:
+                apt_pkg.config.clear(key)
+            else:
+                apt_pkg.config.set(key, value)
+        shutil.rmtree(self.tmpdir)
+
+    def test_records_mmap_fields(self):
+        """records: mapped records agree on Source and translations"""
+        records = apt_pkg.PackageRecords(self.cache)
+        mapped = apt_pkg.PackageRecords(self.cache, mmap=True)
+        fields = ["name", "source_pkg", "source_ver", "short_desc",
+                  "long_desc", "md5_hash", "sha256_hash", "filename"]
+        values = {}
+        for name in ("python-apt-test", "python-apt-test-plain"):
+            verfile = self.cache[name].version_list[0].file_list[0]
+            records.lookup(verfile)
+            mapped.lookup(verfile)
+            for field in fields:
+                self.assertEqual(getattr(mapped, field),
+                                 getattr(records, field))
+            values[name] = dict((field, getattr(mapped, field))
+                                for field in fields)
+        # A Source field with a version and a translated description.
+        test = values["python-apt-test"]
+        self.assertEqual(test["source_pkg"], "python-apt-test-src")
+        self.assertEqual(test["source_ver"], "0.9-2")
+        self.assertEqual(test["short_desc"], "Kurzbeschreibung des Pakets")
+        # A Source field without a version, in the last record of the file.
+        plain = values["python-apt-test-plain"]
+        self.assertEqual(plain["source_pkg"], "python-apt-test-src")
+        self.assertEqual(plain["source_ver"], "")
+        self.assertEqual(plain["short_desc"], "Short description")
+
+if __name__ == "__main__":
+    unittest.main()